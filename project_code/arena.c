@@ -0,0 +1,137 @@
+/**
+ * @file arena.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief A bump allocator for everything that only lives as long as one command 
+ * line. Parsing a line makes many small allocations, the arena hands them out of a 
+ * few large chunks and takes them all back in one step once the line has run. 
+ * @version 0.1
+ * @date 2021-04-14
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <stdlib.h> // for malloc and free
+#include <string.h> // for memcpy
+
+#include "arena.h"
+
+#define ARENA_CHUNK_SIZE 16384 // Bytes in a normal chunk, bigger requests get their own
+#define ARENA_ALIGN 16 // Every allocation is aligned for any type
+
+/**
+ * @brief Makes a new chunk with room for at least size bytes. 
+ * 
+ * @param size The number of bytes needed
+ * @return struct arena_chunk* The new chunk, or NULL if malloc failed
+ */
+static struct arena_chunk *new_chunk(size_t size) {
+  if (size < ARENA_CHUNK_SIZE) {
+    size = ARENA_CHUNK_SIZE; 
+  }
+  struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk) + size); 
+  if (chunk != NULL) {
+    chunk->next = NULL; 
+    chunk->size = size; 
+    chunk->used = 0; 
+  }
+  return chunk; 
+}
+
+/**
+ * @brief Allocates memory from the arena. The memory is not zeroed and is only 
+ * valid until the next arena_reset. 
+ * 
+ * @param arena The arena being allocated from
+ * @param size The number of bytes needed
+ * @return void* The memory, or NULL if malloc failed
+ */
+void * arena_alloc(struct arena *arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1); 
+  struct arena_chunk *chunk = arena->current; 
+
+  if (chunk == NULL) { // First allocation ever
+    chunk = arena->head = arena->current = new_chunk(size); 
+    if (chunk == NULL) {
+      return NULL; 
+    }
+  }
+
+  if (chunk->size - chunk->used < size) {
+    if (chunk->next != NULL && chunk->next->size >= size) { // Reuse a chunk kept by a reset
+      chunk = chunk->next; 
+    } else { // Put a new chunk after the current one
+      struct arena_chunk *added = new_chunk(size); 
+      if (added == NULL) {
+        return NULL; 
+      }
+      added->next = chunk->next; 
+      chunk->next = added; 
+      chunk = added; 
+    }
+    chunk->used = 0; // Chunks after current are only reset once they are reached
+    arena->current = chunk; 
+  }
+
+  void *memory = chunk->data + chunk->used; 
+  chunk->used += size; 
+  return memory; 
+}
+
+/**
+ * @brief Copies up to len characters of a string into the arena. 
+ * 
+ * @param arena The arena being allocated from
+ * @param str The string being copied
+ * @param len The most characters to copy
+ * @return char* The null terminated copy
+ */
+char * arena_strndup(struct arena *arena, const char *str, size_t len) {
+  size_t actual = strnlen(str, len); 
+  char *copy = arena_alloc(arena, actual + 1); 
+  if (copy != NULL) {
+    memcpy(copy, str, actual); 
+    copy[actual] = '\0'; 
+  }
+  return copy; 
+}
+
+/**
+ * @brief Copies a string into the arena. 
+ * 
+ * @param arena The arena being allocated from
+ * @param str The string being copied
+ * @return char* The copy
+ */
+char * arena_strdup(struct arena *arena, const char *str) {
+  return arena_strndup(arena, str, strlen(str)); 
+}
+
+/**
+ * @brief Hands back everything allocated from the arena. The chunks are kept so the 
+ * next command line does not have to malloc them again. 
+ * 
+ * @param arena The arena being reset
+ */
+void arena_reset(struct arena *arena) {
+  arena->current = arena->head; 
+  if (arena->head != NULL) {
+    arena->head->used = 0; 
+  }
+}
+
+/**
+ * @brief Frees every chunk of the arena. 
+ * 
+ * @param arena The arena being freed
+ */
+void arena_free(struct arena *arena) {
+  struct arena_chunk *chunk = arena->head; 
+  while (chunk != NULL) {
+    struct arena_chunk *next = chunk->next; 
+    free(chunk); 
+    chunk = next; 
+  }
+  arena->head = arena->current = NULL; 
+}
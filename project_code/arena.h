@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_INIT { NULL, NULL }
+
+/**
+ * @brief A block of memory that allocations are bumped out of. 
+ * 
+ * @param next The next chunk, kept after a reset so it can be used again
+ * @param size Bytes in data
+ * @param used Bytes of data handed out since the chunk was last started on
+ */
+struct arena_chunk {
+    struct arena_chunk *next; 
+    size_t size; 
+    size_t used; 
+    char data[]; 
+}; 
+
+/**
+ * @brief Bump allocator that owns everything made for one command line. Nothing is 
+ * freed on its own, arena_reset hands all of it back at once. 
+ * 
+ * @param head The first chunk
+ * @param current The chunk allocations are coming from
+ */
+struct arena {
+    struct arena_chunk *head; 
+    struct arena_chunk *current; 
+}; 
+
+void * arena_alloc(struct arena *arena, size_t size); 
+char * arena_strdup(struct arena *arena, const char *str); 
+char * arena_strndup(struct arena *arena, const char *str, size_t len); 
+void arena_reset(struct arena *arena); 
+void arena_free(struct arena *arena); 
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file background.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Keeps track of command lines run in the background with &. Each gets a job 
+ * id, counting up from 1, and is waited for with the wait internal command, either 
+ * by %id or by its pid. Jobs that finish without being waited for are reaped when 
+ * the next one starts, their exit codes are kept for a later wait. 
+ * @version 0.1
+ * @date 2021-04-22
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <errno.h> // for EINTR
+#include <stdlib.h> // for realloc
+#include <sys/wait.h> // for waitpid
+
+#include "background.h"
+#include "executor.h"
+
+/**
+ * @brief A command line running in the background. 
+ * 
+ * @param id The job id printed when it started
+ * @param pid The process running it
+ * @param status Its exit code once done
+ * @param done 1 once it has been reaped
+ */
+struct background_job {
+  int id; 
+  pid_t pid; 
+  int status; 
+  int done; 
+}; 
+
+static struct background_job *jobs = NULL; // Jobs that have not been waited for
+static int num_jobs = 0; 
+static int capacity = 0; 
+static int next_id = 1; 
+
+/**
+ * @brief Reaps a job, blocking until it finishes if asked to. 
+ * 
+ * @param job The job
+ * @param block 1 to wait for it to finish, 0 to only check
+ */
+static void reap(struct background_job *job, int block) {
+  int status; 
+  pid_t result; 
+  if (job->done) {
+    return; 
+  }
+  while ((result = waitpid(job->pid, &status, block ? 0 : WNOHANG)) == -1 && errno == EINTR) {
+    continue; 
+  }
+  if (result == job->pid) {
+    job->status = exit_code_from_status(status); 
+    job->done = 1; 
+  } else if (result == -1) { // Already gone, nothing to report
+    job->status = 127; 
+    job->done = 1; 
+  }
+}
+
+/**
+ * @brief Forgets a job once its exit code has been handed out. 
+ * 
+ * @param index Where the job is in the table
+ */
+static void remove_job(int index) {
+  jobs[index] = jobs[--num_jobs]; 
+}
+
+/**
+ * @brief Starts keeping track of a process running in the background. 
+ * 
+ * @param pid The process
+ * @return int The job id it is given
+ */
+int background_add(pid_t pid) {
+  for (int i = 0; i < num_jobs; i++) { // Finished jobs do not stay zombies
+    reap(&jobs[i], 0); 
+  }
+  if (num_jobs == capacity) {
+    capacity = capacity ? capacity * 2 : 8; 
+    jobs = realloc(jobs, capacity * sizeof(struct background_job)); 
+  }
+  struct background_job *job = &jobs[num_jobs++]; 
+  job->id = next_id++; 
+  job->pid = pid; 
+  job->status = 0; 
+  job->done = 0; 
+  return job->id; 
+}
+
+/**
+ * @brief Waits for one background job. 
+ * 
+ * @param id %N for job N, or the pid of a job
+ * @param status Set to the job's exit code
+ * @return int 0 on success, -1 if there is no such job
+ */
+int background_wait(const char *id, int *status) {
+  int by_job = id[0] == '%'; 
+  char *end; 
+  long number = strtol(id + by_job, &end, 10); 
+  if (id[by_job] == '\0' || *end != '\0') {
+    return -1; 
+  }
+
+  for (int i = 0; i < num_jobs; i++) {
+    if ((by_job && jobs[i].id == number) || (!by_job && jobs[i].pid == number)) {
+      reap(&jobs[i], 1); 
+      *status = jobs[i].status; 
+      remove_job(i); 
+      return 0; 
+    }
+  }
+  return -1; 
+}
+
+/**
+ * @brief Waits for every background job. 
+ * 
+ * @return int The number of jobs waited for
+ */
+int background_wait_all(void) {
+  int count = num_jobs; 
+  for (int i = 0; i < num_jobs; i++) {
+    reap(&jobs[i], 1); 
+  }
+  num_jobs = 0; 
+  return count; 
+}
@@ -0,0 +1,10 @@
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+
+#include <sys/types.h>
+
+int background_add(pid_t pid); 
+int background_wait(const char *id, int *status); 
+int background_wait_all(void); 
+
+#endif
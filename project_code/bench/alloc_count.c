@@ -0,0 +1,44 @@
+/**
+ * @file alloc_count.c
+ * @brief Counts calls to malloc, calloc and realloc for the benchmarks. Linking this 
+ * file in replaces the allocator entry points, including the ones strdup and friends 
+ * use inside libc, and forwards them to glibc's own allocator. 
+ * @version 0.1
+ * @date 2021-04-14
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <stddef.h>
+
+#include "alloc_count.h"
+
+extern void *__libc_malloc(size_t size); 
+extern void *__libc_calloc(size_t num, size_t size); 
+extern void *__libc_realloc(void *ptr, size_t size); 
+extern void __libc_free(void *ptr); 
+
+unsigned long alloc_count = 0; // Allocations since the program started
+unsigned long free_count = 0; // Frees since the program started
+
+void *malloc(size_t size) {
+  alloc_count++; 
+  return __libc_malloc(size); 
+}
+
+void *calloc(size_t num, size_t size) {
+  alloc_count++; 
+  return __libc_calloc(num, size); 
+}
+
+void *realloc(void *ptr, size_t size) {
+  alloc_count++; 
+  return __libc_realloc(ptr, size); 
+}
+
+void free(void *ptr) {
+  if (ptr != NULL) {
+    free_count++; 
+  }
+  __libc_free(ptr); 
+}
@@ -0,0 +1,7 @@
+#ifndef ALLOC_COUNT_H
+#define ALLOC_COUNT_H
+
+extern unsigned long alloc_count; 
+extern unsigned long free_count; 
+
+#endif
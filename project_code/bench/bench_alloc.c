@@ -0,0 +1,53 @@
+/**
+ * @file bench_alloc.c
+ * @brief Counts the allocations made parsing and clearing a 100k line script, the 
+ * same way run_parser_executor_handler does for every line it runs. 
+ * @version 0.1
+ * @date 2021-04-14
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "../datastructures.h"
+#include "alloc_count.h"
+
+#define SCRIPT_LINES 100000 // Lines parsed
+
+// A mix of the lines found in our scripts
+static const char *lines[] = {
+  "ls -l /tmp | grep sush | wc -l", 
+  "setenv BUILD_DIR /home/build/output", 
+  "cat < input.txt > output.txt", 
+  "echo \"hello world\" >> log.txt", 
+  "gcc -O2 -Wall -o prog main.c util.c parser.c -lm", 
+  "sort -u names.txt | uniq -c | sort -rn | head -n 10", 
+  "getenv HOME", 
+  "grep -v \"^#\" config.ini > clean.ini", 
+}; 
+
+int main(int argc, char **argv) {
+  LIST_HEAD(list_commands); 
+  struct arena arena = ARENA_INIT; 
+  commandline cmdline = { .arena = &arena }; 
+  char input[4096]; 
+  int num_lines = sizeof(lines) / sizeof(lines[0]); 
+
+  unsigned long start = alloc_count; 
+  for (int i = 0; i < SCRIPT_LINES; i++) {
+    strcpy(input, lines[i % num_lines]); 
+    cmdline.line = input; 
+    parse_commandline(&cmdline, &list_commands); 
+
+    // What runner.c does once the line has run
+    arena_reset(&arena); 
+    INIT_LIST_HEAD(&list_commands); 
+  }
+  unsigned long total = alloc_count - start; 
+
+  printf("lines %d allocations %lu allocations/line %.3f\n", SCRIPT_LINES, total, (double)total / SCRIPT_LINES); 
+  arena_free(&arena); 
+  return 0; 
+}
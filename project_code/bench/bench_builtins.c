@@ -0,0 +1,91 @@
+/**
+ * @file bench_builtins.c
+ * @brief Measures what each use of echo, printf, true and test costs in a script, 
+ * run as a builtin and run as the program on PATH. Each command is written to a 
+ * script thousands of times and the script is run with sush, the time of an empty 
+ * script is taken off so only the commands are counted. 
+ * @version 0.1
+ * @date 2021-04-18
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define LINES 2000 // Times the command is in the script
+#define SHELL "./sush" // Shell being measured
+
+extern char **environ; 
+
+/**
+ * @brief Gets the current monotonic time in microseconds. 
+ * 
+ * @return double Microseconds 
+ */
+static double now_us(void) {
+  struct timespec ts; 
+  clock_gettime(CLOCK_MONOTONIC, &ts); 
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3; 
+}
+
+/**
+ * @brief Writes a script running a command lines times, then times sush running it 
+ * with its output thrown away. 
+ * 
+ * @param command The command line, NULL for an empty script
+ * @param lines Times the command is in the script
+ * @return double Microseconds the script took
+ */
+static double time_script(const char *command, int lines) {
+  char script[] = "/tmp/bench_builtins_XXXXXX"; 
+  int fd = mkstemp(script); 
+  FILE *file = fdopen(fd, "w"); 
+  for (int i = 0; command != NULL && i < lines; i++) {
+    fprintf(file, "%s\n", command); 
+  }
+  fclose(file); 
+
+  posix_spawn_file_actions_t actions; 
+  posix_spawn_file_actions_init(&actions); 
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0); 
+  char *args[] = { SHELL, script, NULL }; 
+  pid_t pid; 
+
+  double start = now_us(); 
+  if (posix_spawn(&pid, SHELL, &actions, NULL, args, environ) != 0) {
+    perror(SHELL); 
+    exit(1); 
+  }
+  waitpid(pid, NULL, 0); 
+  double elapsed = now_us() - start; 
+
+  posix_spawn_file_actions_destroy(&actions); 
+  unlink(script); 
+  return elapsed; 
+}
+
+int main(int argc, char **argv) {
+  const char *commands[][2] = {
+    { "true", "/bin/true" }, 
+    { "echo hello world", "/bin/echo hello world" }, 
+    { "printf \"%s %d\\n\" count 42", "/usr/bin/printf \"%s %d\\n\" count 42" }, 
+    { "test 3 -lt 5", "/usr/bin/test 3 -lt 5" }, 
+  }; 
+  int num_commands = sizeof(commands) / sizeof(commands[0]); 
+  double empty = time_script(NULL, 0); 
+
+  printf("%-36s %-16s %-16s\n", "command", "builtin us/op", "program us/op"); 
+  for (int c = 0; c < num_commands; c++) {
+    double builtin = (time_script(commands[c][0], LINES) - empty) / LINES; 
+    double program = (time_script(commands[c][1], LINES) - empty) / LINES; 
+    printf("%-36s %-16.2f %-16.2f\n", commands[c][0], builtin, program); 
+  }
+  return 0; 
+}
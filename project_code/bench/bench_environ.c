@@ -0,0 +1,74 @@
+/**
+ * @file bench_environ.c
+ * @brief Microbenchmark for environment lookups. Fills the shell's environment list
+ * with more and more variables and times get_env and set_env at each size, the time
+ * per lookup should stay flat as the environment grows. 
+ * @version 0.1
+ * @date 2021-04-08
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../environ.h"
+
+#define LOOKUPS 1000000 // Lookups timed at each size
+
+/**
+ * @brief Gets the current monotonic time in nanoseconds. 
+ * 
+ * @return double Nanoseconds 
+ */
+static double now_ns(void) {
+  struct timespec ts; 
+  clock_gettime(CLOCK_MONOTONIC, &ts); 
+  return ts.tv_sec * 1e9 + ts.tv_nsec; 
+}
+
+int main(int argc, char **argv) {
+  LIST_HEAD(list_env); 
+  int sizes[] = { 10, 100, 1000, 10000 }; 
+  char name[32]; 
+  int count = 0; 
+  volatile unsigned long sink = 0; // Keeps the lookups from being optimized away
+
+  printf("%-10s %-16s %-16s %-16s\n", "variables", "get_env ns/op", "miss ns/op", "set_env ns/op"); 
+  for (int s = 0; s < 4; s++) {
+    // Grow the environment to the next size
+    while (count < sizes[s]) {
+      snprintf(name, sizeof(name), "BENCH_VAR_%d", count++); 
+      set_env(&list_env, name, "some value"); 
+    }
+
+    srand(1); 
+    double start = now_ns(); 
+    for (int i = 0; i < LOOKUPS; i++) {
+      snprintf(name, sizeof(name), "BENCH_VAR_%d", rand() % count); 
+      sink += (unsigned long)get_env(&list_env, name); 
+    }
+    double hit = (now_ns() - start) / LOOKUPS; 
+
+    start = now_ns(); 
+    for (int i = 0; i < LOOKUPS; i++) {
+      snprintf(name, sizeof(name), "MISSING_VAR_%d", rand() % count); 
+      sink += (unsigned long)get_env(&list_env, name); 
+    }
+    double miss = (now_ns() - start) / LOOKUPS; 
+
+    start = now_ns(); 
+    for (int i = 0; i < LOOKUPS; i++) {
+      snprintf(name, sizeof(name), "BENCH_VAR_%d", rand() % count); 
+      set_env(&list_env, name, "another value"); 
+    }
+    double set = (now_ns() - start) / LOOKUPS; 
+
+    printf("%-10d %-16.1f %-16.1f %-16.1f\n", count, hit, miss, set); 
+  }
+
+  clear_list_env(&list_env); 
+  return 0; 
+}
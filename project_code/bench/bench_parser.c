@@ -0,0 +1,131 @@
+/**
+ * @file bench_parser.c
+ * @brief Parser throughput benchmark. Parses a corpus of generated command lines
+ * (long pipelines, many redirects, quoted strings and very long argument lists) the
+ * same way run_parser_executor_handler does, and reports lines/s, bytes/s and
+ * allocations per line for each kind of line. The results are also written as JSON
+ * so runs can be compared.
+ * @version 0.1
+ * @date 2021-04-15
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../datastructures.h"
+#include "alloc_count.h"
+
+#define CORPUS_BYTES (8 * 1024 * 1024) // Roughly how much of each kind of line is parsed
+#define RESULTS_FILE "bench/bench_parser.json" // Default place the results are written
+
+/**
+ * @brief One kind of line in the corpus.
+ *
+ * @param name Name the results are reported under
+ * @param line The line, generated once and copied before every parse
+ * @param length Length of line
+ */
+struct corpus_line {
+  const char *name;
+  char *line;
+  int length;
+};
+
+/**
+ * @brief Gets the current monotonic time in nanoseconds.
+ *
+ * @return double Nanoseconds
+ */
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Builds a line out of a piece repeated count times after a prefix.
+ *
+ * @param prefix Start of the line
+ * @param piece Text that is repeated, %d is replaced by the repetition number
+ * @param count How many times piece is repeated
+ * @return char* The line, freed by the caller
+ */
+static char *repeat_line(const char *prefix, const char *piece, int count) {
+  size_t size = strlen(prefix) + (strlen(piece) + 16) * count + 1;
+  char *line = malloc(size);
+  int used = sprintf(line, "%s", prefix);
+  for (int i = 0; i < count; i++) {
+    used += sprintf(line + used, piece, i);
+  }
+  return line;
+}
+
+int main(int argc, char **argv) {
+  const char *results_file = argc > 1 ? argv[1] : RESULTS_FILE;
+  struct corpus_line corpus[] = {
+    { "short", strdup("ls -l /tmp | grep sush | wc -l"), 0 },
+    { "pipeline", repeat_line("cat input.txt", " | grep -v pattern%d", 64), 0 },
+    { "redirects", strdup("grep -v \"^#\" < config.ini | sort -u | uniq -c >> counts.txt"), 0 },
+    { "quoted", repeat_line("echo", " \"quoted string %d with spaces\" plain\"joined\"", 200), 0 },
+    { "wide", repeat_line("gcc -O2 -o prog", " src/file%d.c", 10000), 0 },
+  };
+  int num_lines = sizeof(corpus) / sizeof(corpus[0]);
+  LIST_HEAD(list_commands);
+  struct arena arena = ARENA_INIT;
+  commandline cmdline = { .arena = &arena };
+
+  FILE *results = fopen(results_file, "w");
+  if (results == NULL) {
+    perror(results_file);
+    return 1;
+  }
+  fprintf(results, "{\"benchmark\": \"parser\", \"results\": [");
+
+  printf("%-10s %-10s %-10s %-14s %-14s %-12s\n", "kind", "bytes", "lines", "lines/s", "MB/s", "allocs/line");
+  for (int c = 0; c < num_lines; c++) {
+    corpus[c].length = strlen(corpus[c].line);
+    int iterations = CORPUS_BYTES / corpus[c].length + 1;
+    char *input = malloc(corpus[c].length + 1);
+
+    unsigned long allocs = alloc_count;
+    double start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+      // The parser splits the line up in place, so every parse gets a fresh copy
+      memcpy(input, corpus[c].line, corpus[c].length + 1);
+      cmdline.line = input;
+      if (parse_commandline(&cmdline, &list_commands) == -1) {
+        fprintf(stderr, "%s line did not parse\n", corpus[c].name);
+        return 1;
+      }
+
+      // What runner.c does once the line has run
+      arena_reset(&arena);
+      INIT_LIST_HEAD(&list_commands);
+    }
+    double seconds = (now_ns() - start) / 1e9;
+    double per_line = (double)(alloc_count - allocs) / iterations;
+    double lines_per_sec = iterations / seconds;
+    double bytes_per_sec = (double)iterations * corpus[c].length / seconds;
+
+    printf("%-10s %-10d %-10d %-14.0f %-14.1f %-12.3f\n", corpus[c].name, corpus[c].length,
+           iterations, lines_per_sec, bytes_per_sec / 1e6, per_line);
+    fprintf(results, "%s\n  {\"kind\": \"%s\", \"line_bytes\": %d, \"lines\": %d, \"seconds\": %.6f, "
+            "\"lines_per_sec\": %.1f, \"bytes_per_sec\": %.1f, \"allocs_per_line\": %.3f}",
+            c == 0 ? "" : ",", corpus[c].name, corpus[c].length, iterations, seconds,
+            lines_per_sec, bytes_per_sec, per_line);
+
+    free(input);
+    free(corpus[c].line);
+  }
+  fprintf(results, "\n]}\n");
+  fclose(results);
+  printf("results written to %s\n", results_file);
+
+  arena_free(&arena);
+  return 0;
+}
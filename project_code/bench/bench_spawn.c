@@ -0,0 +1,77 @@
+/**
+ * @file bench_spawn.c
+ * @brief Measures how long it takes to start and reap /bin/true with each launcher 
+ * while the shell's resident set is 10 MB to 1 GB. fork copies the page tables of 
+ * the whole process, so its cost grows with the shell, posix_spawn should not. 
+ * @version 0.1
+ * @date 2021-04-12
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../executor.h"
+
+#define SPAWNS 200 // Commands started for each measurement
+
+/**
+ * @brief Gets the current monotonic time in microseconds. 
+ * 
+ * @return double Microseconds 
+ */
+static double now_us(void) {
+  struct timespec ts; 
+  clock_gettime(CLOCK_MONOTONIC, &ts); 
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3; 
+}
+
+/**
+ * @brief Starts and reaps /bin/true SPAWNS times. 
+ * 
+ * @param env The environment passed to the command
+ * @return double The average microseconds per command
+ */
+static double time_spawns(char **env) {
+  char *args[] = { "/bin/true", NULL }; 
+  double start = now_us(); 
+  for (int i = 0; i < SPAWNS; i++) {
+    pid_t pid = spawn_command(args, env, STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO); 
+    waitpid(pid, NULL, 0); 
+  }
+  return (now_us() - start) / SPAWNS; 
+}
+
+int main(int argc, char **argv, char **envp) {
+  int sizes_mb[] = { 10, 100, 250, 500, 1000 }; 
+  size_t held = 0; 
+  char *memory = NULL; 
+
+  printf("%-10s %-18s %-18s\n", "rss MB", "fork us/spawn", "posix_spawn us/spawn"); 
+  for (int s = 0; s < 5; s++) {
+    // Grow the resident set by touching every page
+    size_t bytes = (size_t)sizes_mb[s] << 20; 
+    memory = realloc(memory, bytes); 
+    if (memory == NULL) {
+      perror("realloc"); 
+      return 1; 
+    }
+    memset(memory + held, 1, bytes - held); 
+    held = bytes; 
+
+    set_launcher(LAUNCH_FORK); 
+    double forked = time_spawns(envp); 
+    set_launcher(LAUNCH_SPAWN); 
+    double spawned = time_spawns(envp); 
+    printf("%-10d %-18.1f %-18.1f\n", sizes_mb[s], forked, spawned); 
+  }
+
+  free(memory); 
+  return 0; 
+}
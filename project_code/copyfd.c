@@ -0,0 +1,228 @@
+/**
+ * @file copyfd.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Moves everything left in one file descriptor to another. Where the kernel 
+ * can do it the bytes never come up to the shell: copy_file_range between files, 
+ * splice when either end is a pipe and sendfile from a file. Anything else, or a 
+ * kernel that refuses, falls back to read and write. A byte range of a file can be 
+ * copied the same way without moving the file's position. 
+ * @version 0.1
+ * @date 2021-04-19
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#define _GNU_SOURCE // for splice and copy_file_range
+#include <errno.h> // for errno
+#include <fcntl.h> // for splice
+#include <stdlib.h> // for malloc
+#include <sys/sendfile.h> // for sendfile
+#include <sys/stat.h> // for fstat
+#include <unistd.h> // for copy_file_range, pread, read and write
+
+#include "copyfd.h"
+
+#define READ_WRITE_SIZE 131072 // Buffer used when the kernel cannot move the bytes itself
+
+/**
+ * @brief The ways bytes can be moved, tried in this order. 
+ */
+enum Copy_Method {
+  COPY_FILE_RANGE, 
+  COPY_SPLICE, 
+  COPY_SENDFILE, 
+  COPY_READ_WRITE
+}; 
+
+/**
+ * @brief Checks if an error means the method can not be used on these descriptors, 
+ * rather than that the copy failed. 
+ * 
+ * @param error The errno the method failed with
+ * @return int 1 if the next method should be tried, else 0
+ */
+static int unsupported(int error) {
+  return error == EINVAL || error == ENOSYS || error == EXDEV || error == EOPNOTSUPP || 
+         error == EBADF || error == ESPIPE; 
+}
+
+/**
+ * @brief Moves bytes with read and write. 
+ * 
+ * @param in_fd Where the bytes come from
+ * @param out_fd Where the bytes go
+ * @return int 0 once in_fd is at its end, -1 on error
+ */
+static int copy_read_write(int in_fd, int out_fd) {
+  char *buf = malloc(READ_WRITE_SIZE); 
+  if (buf == NULL) {
+    return -1; 
+  }
+
+  int result = 0; 
+  for (;;) {
+    ssize_t got = read(in_fd, buf, READ_WRITE_SIZE); 
+    if (got == -1 && errno == EINTR) {
+      continue; 
+    } else if (got <= 0) {
+      result = got == 0 ? 0 : -1; 
+      break; 
+    }
+    for (ssize_t done = 0; done < got; ) {
+      ssize_t written = write(out_fd, buf + done, got - done); 
+      if (written == -1 && errno == EINTR) {
+        continue; 
+      } else if (written == -1) {
+        free(buf); 
+        return -1; 
+      }
+      done += written; 
+    }
+  }
+  free(buf); 
+  return result; 
+}
+
+/**
+ * @brief Moves one chunk with a method the kernel does the copying for. The file 
+ * positions of both descriptors are used and moved, so a copy can switch methods 
+ * part way through. 
+ * 
+ * @param method The method used
+ * @param in_fd Where the bytes come from
+ * @param out_fd Where the bytes go
+ * @return ssize_t Bytes moved, 0 at the end of in_fd, -1 on error
+ */
+static ssize_t copy_chunk(enum Copy_Method method, int in_fd, int out_fd) {
+  switch (method) {
+    case COPY_FILE_RANGE: 
+      return copy_file_range(in_fd, NULL, out_fd, NULL, COPY_CHUNK, 0); 
+    case COPY_SPLICE: 
+      return splice(in_fd, NULL, out_fd, NULL, COPY_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE); 
+    default: 
+      return sendfile(out_fd, in_fd, NULL, COPY_CHUNK); 
+  }
+}
+
+/**
+ * @brief Picks the method to try after one the kernel refused. 
+ * 
+ * @param method The method that was refused
+ * @param in_is_file 1 if in_fd is a regular file
+ * @return enum Copy_Method The next method
+ */
+static enum Copy_Method next_method(enum Copy_Method method, int in_is_file) {
+  if (method == COPY_FILE_RANGE || (method == COPY_SPLICE && in_is_file)) {
+    return COPY_SENDFILE; 
+  }
+  return COPY_READ_WRITE; 
+}
+
+/**
+ * @brief Copies everything from in_fd's current position to its end into out_fd. 
+ * 
+ * @param in_fd Where the bytes come from
+ * @param out_fd Where the bytes go
+ * @return int 0 on success, -1 with errno set on error
+ */
+int copy_fd(int in_fd, int out_fd) {
+  struct stat in_sb, out_sb; 
+  if (fstat(in_fd, &in_sb) == -1 || fstat(out_fd, &out_sb) == -1) {
+    return -1; 
+  }
+
+  // Files like those in /proc say they are empty, only reading them shows what is there
+  int in_is_file = S_ISREG(in_sb.st_mode) && in_sb.st_size > 0; 
+  enum Copy_Method method; 
+  if (in_is_file && S_ISREG(out_sb.st_mode)) {
+    method = COPY_FILE_RANGE; 
+  } else if (S_ISFIFO(in_sb.st_mode) || S_ISFIFO(out_sb.st_mode)) {
+    method = COPY_SPLICE; 
+  } else if (in_is_file) {
+    method = COPY_SENDFILE; 
+  } else {
+    method = COPY_READ_WRITE; 
+  }
+
+  while (method != COPY_READ_WRITE) {
+    ssize_t moved = copy_chunk(method, in_fd, out_fd); 
+    if (moved == 0) {
+      return 0; 
+    } else if (moved == -1 && errno == EINTR) {
+      continue; 
+    } else if (moved == -1 && unsupported(errno)) {
+      method = next_method(method, in_is_file); 
+    } else if (moved == -1) {
+      return -1; 
+    }
+  }
+  return copy_read_write(in_fd, out_fd); 
+}
+
+/**
+ * @brief Copies length bytes of a file starting at offset into out_fd, leaving the 
+ * file's position alone so several ranges of one descriptor can be copied at once. 
+ * 
+ * @param in_fd The file the bytes come from
+ * @param offset Where the range starts
+ * @param length How many bytes to copy, fewer are copied if the file ends first
+ * @param out_fd Where the bytes go
+ * @return int 0 on success, -1 with errno set on error
+ */
+int copy_range(int in_fd, off_t offset, off_t length, int out_fd) {
+  struct stat out_sb; 
+  if (fstat(out_fd, &out_sb) == -1) {
+    return -1; 
+  }
+
+  enum Copy_Method method = S_ISFIFO(out_sb.st_mode) ? COPY_SPLICE : COPY_SENDFILE; 
+  while (length > 0 && method != COPY_READ_WRITE) {
+    size_t chunk = length < COPY_CHUNK ? length : COPY_CHUNK; 
+    ssize_t moved = method == COPY_SPLICE ? splice(in_fd, &offset, out_fd, NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE) 
+                                          : sendfile(out_fd, in_fd, &offset, chunk); // Both move offset
+    if (moved == 0) {
+      return 0; 
+    } else if (moved == -1 && errno == EINTR) {
+      continue; 
+    } else if (moved == -1 && unsupported(errno)) {
+      method = next_method(method, 1); 
+    } else if (moved == -1) {
+      return -1; 
+    } else {
+      length -= moved; 
+    }
+  }
+  if (length == 0) {
+    return 0; 
+  }
+
+  char *buf = malloc(READ_WRITE_SIZE); 
+  if (buf == NULL) {
+    return -1; 
+  }
+  while (length > 0) {
+    ssize_t got = pread(in_fd, buf, length < READ_WRITE_SIZE ? length : READ_WRITE_SIZE, offset); 
+    if (got == -1 && errno == EINTR) {
+      continue; 
+    } else if (got <= 0) {
+      free(buf); 
+      return got == 0 ? 0 : -1; 
+    }
+    for (ssize_t done = 0; done < got; ) {
+      ssize_t written = write(out_fd, buf + done, got - done); 
+      if (written == -1 && errno == EINTR) {
+        continue; 
+      } else if (written == -1) {
+        free(buf); 
+        return -1; 
+      }
+      done += written; 
+    }
+    offset += got; 
+    length -= got; 
+  }
+  free(buf); 
+  return 0; 
+}
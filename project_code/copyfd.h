@@ -0,0 +1,11 @@
+#ifndef COPYFD_H
+#define COPYFD_H
+
+#define COPY_CHUNK (1 << 20) // Most bytes moved by one call into the kernel
+
+#include <sys/types.h>
+
+int copy_fd(int in_fd, int out_fd); 
+int copy_range(int in_fd, off_t offset, off_t length, int out_fd); 
+
+#endif
@@ -18,7 +18,11 @@
 
 // Imports
 #include <string.h> // for strings
+#include <sys/types.h> // for pid_t
+#include <sys/resource.h> // for struct rusage
+#include <time.h> // for struct timespec
 #include "list.h" // for navigating lists
+#include "arena.h" // for the command line's allocations
 
 /**
  * @brief Enum to describe what type of argument is held. 
@@ -29,57 +33,113 @@ enum Token
   REDIRECT_OUTPUT_APPEND,
   REDIRECT_OUTPUT_TRUNCATE,
   NORMAL,
-  FILENAME
+  FILENAME,
+  SEPARATOR,
+  REDIRECT_HEREDOC, // <<, the input is the lines up to a delimiter
+  REDIRECT_HEREDOC_STRIP, // <<-, leading tabs are taken off the lines
+  REDIRECT_HERESTRING, // <<<, the input is one word and a newline
+  PROCESS_SUB_INPUT, // <(command), an arg naming a pipe the command's output can be read from
+  PROCESS_SUB_OUTPUT, // >(command), an arg naming a pipe that feeds the command's input
+  BACKGROUND // &, only allowed at the end of the line
 };
 
 /**
  * @brief Enum to describe the status of the job commands.  
  */
 enum Job_Status {
-  COMPLETE, QUEUED, RUNNING
+  COMPLETE, QUEUED, RUNNING, CANCELED
 }; 
 
 /**
- * @brief Struct to hold individual arguments in a subcommand. 
+ * @brief A token on the command line, a slice of the line rather than a copy of it. 
  * 
- * @param contents the input
- * @param Token enum to describe what type of argument we have
- * @param list_head list to navigate through, linking to next and prev argument
+ * @param offset Where the token starts in the line
+ * @param length The number of characters in the token
+ * @param kind Enum to describe what type of token we have
  */
-typedef struct Argument {
-    char *contents; // Contents
-    enum Token token; 
-    struct list_head list;
-} argument; 
+struct token {
+  int offset; 
+  int length; 
+  enum Token kind; 
+}; 
 
 
 /**
  * @brief Commandline - the full line of input from the user
  * 
  * @param num int number of subcommands
- * @param subcommand 2D char array of all subcommands
- * @param stdin 2D char array to hold where input of the function comes from
- * @param stdout 2D char array to hold where the command outputs to
+ * @param line The line as it was read, the parser splits it up in place
+ * @param arena The arena that everything parsed from the line is allocated from
+ * @param background 1 if the line ended with &, so it runs without being waited for
  */
 typedef struct Commandline {
   int num; 
-  char **subcommand; 
+  char *line; 
+  struct arena *arena; 
+  int background; 
 } commandline;
 
+/**
+ * @brief What one subcommand cost to run, filled in by the executor. 
+ * 
+ * @param start When it was started, from CLOCK_MONOTONIC
+ * @param launched When the shell was done starting it, only recorded while tracing
+ * @param end When it finished, from CLOCK_MONOTONIC
+ * @param rusage The resources it used, from wait4 or the thread that ran it
+ */
+struct stage_usage {
+    struct timespec start; 
+    struct timespec launched; 
+    struct timespec end; 
+    struct rusage rusage; 
+}; 
+
+/**
+ * @brief A process substitution in a subcommand's args. The command runs next to the 
+ * subcommand, connected to it by a pipe the subcommand opens by its /dev/fd path. 
+ * 
+ * @param arg Which of the subcommand's args it is
+ * @param kind PROCESS_SUB_INPUT or PROCESS_SUB_OUTPUT
+ * @param command The command line run
+ * @param fd The shell's end of the pipe, -1 when the command is not running
+ * @param pid The process running the command, 0 when it is not running
+ * @param path The /dev/fd path the arg is replaced with
+ */
+struct process_sub {
+    int arg; 
+    enum Token kind; 
+    char *command; 
+    int fd; 
+    pid_t pid; 
+    char path[24]; 
+}; 
+
 /**
  * @brief subcommand - a sub command from the full commandline (sub commands are split at the pipes)
  * 
  * @param exec_args A parsed subcommand ending with NULL
- * @param input The input of the command (stdin, file name)
+ * @param input The input of the command (stdin, file name, here-document body or here-string)
+ * @param input_type How input is used, NORMAL if there is no input redirect
  * @param output The output of the command (stdout, file name)
  * @param type The type of redirect
+ * @param pid The process id the subcommand was started as (0 if never started)
+ * @param status The exit status of the subcommand once it has been reaped
+ * @param usage What the subcommand cost to run
+ * @param subs The process substitutions in exec_args
+ * @param num_subs The number of process substitutions
  * @param list The list which subcommand points to
  */
 struct subcommand {
     char **exec_args; 
     char *input; 
+    enum Token input_type; 
     char *output; 
     enum Token type; 
+    pid_t pid; 
+    int status; 
+    struct stage_usage usage; 
+    struct process_sub *subs; 
+    int num_subs; 
     struct list_head list; 
 }; 
 
@@ -88,40 +148,31 @@ struct subcommand {
  */
 struct job_command {
   char **exec_args; ///< The 2D array sent to args
+  char **env; ///< the environment the job was queued with
   char *output_file; ///< the output file where the command outputs 
   enum Job_Status status; ///< the current status of the job
   int position; ///< the position of the job in the queue
   int process_id; ///< the process ID that the job is running on
+  int pidfd; ///< the pidfd used to notice the job exiting, -1 when not running
+  int exit_status; ///< the exit code of the job once it is complete
+  int *after; ///< the task numbers that must complete successfully before the job starts
+  int num_after; ///< the number of tasks in after
+  struct job_worker *worker; ///< the worker running the job, NULL when it runs in this shell
+  int socket; ///< the connection to the worker running the job, -1 when there is none
+  int output_fd; ///< the output file being written for a job running on a worker
+  struct frame_reader *reader; ///< the frame being read from the worker, NULL when there is none
   struct list_head queue; ///< the queue that the job belongs to
 };
 
-/**
- * @brief Find the number of subcommands in the input string and returns that value. 
- * 
- * @param input String to search through
- * @param len int length of String
- * @return int number of subcommands found
- */
-int find_num_subcommands(char input[], int len);
-
-/**
- * @brief Copy a String of subcommands into a 2D array of subcommands. 
- * 
- * @param input String to break apart
- * @param num int number of subcommands in String
- * @param subcommand 2D char array to copy subcommands into
- */
-void copy_subcommands(char input[], int num, char **subcommand);
-
 /**
  * @brief Creates a list of commands, or subcommand structs, where each 
  * subcommand is parsed and marked with the appropiate input and output. 
+ * The arguments point into commandline->line, which is modified in place. 
  * 
- * @param list_args A list used to store the parsed arguments of a subcommand
- * @param commandline The struct which stores unparsed subcommands, and number of subcommands. 
+ * @param commandline The struct which holds the line, and gets the number of subcommands. 
  * @param list_commands The list that stores the subcommands 
  * @return int Returns -1 if there was an error, else returns 0
  */
-int parse_commandline(struct list_head *list_args, commandline *commandline, struct list_head *list_commands);
+int parse_commandline(commandline *commandline, struct list_head *list_commands);
 
 #endif
\ No newline at end of file
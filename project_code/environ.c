@@ -14,8 +14,181 @@
 #include <stdlib.h> // For malloc, calloc, free, etc
 
 #include "environ.h" // Header file
+#include "trace.h" // for counting copied entries
 
 #define BUFFER_SIZE 4096 // Max size of a char*
+#define INDEX_MIN_CAPACITY 64 // Smallest number of slots in the index, a power of two
+#define INDEX_TOMBSTONE ((struct environment *)-1) // Marks a slot whose variable was removed
+
+/**
+ * @brief Open addressing hash index over the environment list, so variables can be 
+ * found without walking the list. The list still owns the variables and keeps them 
+ * in the order they were added, the index only points into it. The index is built 
+ * for one list at a time and is rebuilt if a different list is changed. Only the 
+ * functions that change a list build or grow the index, lookups never change it, 
+ * since builtins running in threads read the environment at the same time. 
+ * 
+ * @param list The list the index was built for
+ * @param slots Array of capacity slots, each NULL, INDEX_TOMBSTONE or a variable
+ * @param capacity Number of slots, always a power of two
+ * @param used Number of slots that are not NULL, including tombstones
+ */
+static struct env_index {
+  struct list_head *list; 
+  struct environment **slots; 
+  unsigned long capacity; 
+  unsigned long used; 
+} env_index; 
+
+/**
+ * @brief The envp array handed to exec, cached between commands. The array points 
+ * straight at the contents of the variables in the list, so it is only rebuilt after 
+ * a variable is set or unset, and is never copied. 
+ * 
+ * @param list The list the array was built for
+ * @param envp NULL terminated array of NAME=value strings owned by the list
+ * @param capacity Number of pointers envp has room for
+ * @param dirty Set when the list has changed since envp was built
+ */
+static struct env_array_cache {
+  struct list_head *list; 
+  char **envp; 
+  int capacity; 
+  int dirty; 
+} env_array; 
+
+/**
+ * @brief Marks the cached envp array of a list as out of date. 
+ * 
+ * @param list The list that changed
+ */
+static void env_array_invalidate(struct list_head *list) {
+  if (env_array.list == list) {
+    env_array.dirty = 1; 
+  }
+}
+
+/**
+ * @brief Hashes an environment variable name with 64 bit FNV-1a. 
+ * 
+ * @param name The name being hashed, ends at a null term or an equals sign
+ * @return unsigned long The hash of the name
+ */
+static unsigned long hash_name(const char *name) {
+  unsigned long hash = 14695981039346656037UL; 
+  while (*name != '\0' && *name != '=') {
+    hash ^= (unsigned char)*name++; 
+    hash *= 1099511628211UL; 
+  }
+  return hash; 
+}
+
+/**
+ * @brief Finds the slot holding the variable with the given name. 
+ * 
+ * @param name The name of the variable
+ * @param hash The hash of name
+ * @return unsigned long The slot of the variable, or env_index.capacity if it is not there
+ */
+static unsigned long index_find(const char *name, unsigned long hash) {
+  unsigned long mask = env_index.capacity - 1; 
+  unsigned long i = hash & mask; 
+
+  // Linear probe until an empty slot, tombstones are stepped over
+  while (env_index.slots[i] != NULL) {
+    struct environment *env = env_index.slots[i]; 
+    if (env != INDEX_TOMBSTONE && env->hash == hash && strcmp(env->name, name) == 0) {
+      return i; 
+    }
+    i = (i + 1) & mask; 
+  }
+  return env_index.capacity; 
+}
+
+/**
+ * @brief Puts a variable in the first free slot for its hash. The index must have 
+ * room and must not already contain the variable. 
+ * 
+ * @param env The variable being added to the index
+ */
+static void index_insert(struct environment *env) {
+  unsigned long mask = env_index.capacity - 1; 
+  unsigned long i = env->hash & mask; 
+
+  while (env_index.slots[i] != NULL && env_index.slots[i] != INDEX_TOMBSTONE) {
+    i = (i + 1) & mask; 
+  }
+  if (env_index.slots[i] == NULL) {
+    env_index.used++; 
+  }
+  env_index.slots[i] = env; 
+}
+
+/**
+ * @brief Rebuilds the index for a list with enough room for extra more variables 
+ * than the list holds. Tombstones are dropped. 
+ * 
+ * @param list The list the index is built for
+ * @param extra How many more variables the index should have room for
+ */
+static void index_rebuild(struct list_head *list, unsigned long extra) {
+  unsigned long needed = (getListLength(list) + extra) * 2; // Keep the load under one half
+  unsigned long capacity = INDEX_MIN_CAPACITY; 
+  while (capacity < needed) {
+    capacity *= 2; 
+  }
+
+  free(env_index.slots); 
+  env_index.slots = calloc(capacity, sizeof(struct environment *)); 
+  env_index.capacity = capacity; 
+  env_index.used = 0; 
+  env_index.list = list; 
+
+  struct list_head *curr; 
+  for (curr = list->next; curr != list; curr = curr->next) {
+    index_insert(list_entry(curr, struct environment, list)); 
+  }
+}
+
+/**
+ * @brief Makes sure the index belongs to list and has room for one more variable. 
+ * Only called when the list is about to change. 
+ * 
+ * @param list The list that is about to be added to or removed from
+ */
+static void index_prepare(struct list_head *list) {
+  if (env_index.list != list) {
+    index_rebuild(list, 0); 
+  } else if ((env_index.used + 1) * 2 > env_index.capacity) {
+    index_rebuild(list, 1); 
+  }
+}
+
+/**
+ * @brief Finds a variable in the list through the index, or by walking the list if 
+ * the index was built for another one. Neither the list nor the index is changed. 
+ * 
+ * @param list The list of environment variables
+ * @param name The name of the variable
+ * @return struct environment* The variable, or NULL if it is not in the list
+ */
+static struct environment *find_env(struct list_head *list, const char *name) {
+  if (env_index.list != list) {
+    struct list_head *curr; 
+    for (curr = list->next; curr != list; curr = curr->next) {
+      struct environment *env = list_entry(curr, struct environment, list); 
+      if (strcmp(env->name, name) == 0) {
+        return env; 
+      }
+    }
+    return NULL; 
+  }
+  unsigned long slot = index_find(name, hash_name(name)); 
+  if (slot == env_index.capacity) {
+    return NULL; 
+  }
+  return env_index.slots[slot]; 
+}
 
 /**
  * @brief Used by set_env to update the contents in the environment struct. 
@@ -26,14 +199,31 @@
  * @param list The list of environment variables
  */
 static void set_env_update_contents(struct environment *env, char *name, char *value, struct list_head *list) {
-  int len = strlen(name) + strlen(value) + 2; // Length of strings and null terms 
-  env->contents = calloc(len, sizeof(char)); // Allocate to fit new contents
-  strcat(env->contents, name); // Copy new name
-  strcat(env->contents, "="); // Copy equals sign
-  strcat(env->contents, value); // Copy value
+  int name_len = strlen(name); 
+  int value_len = strlen(value); 
+  env->contents = malloc(name_len + value_len + 2); // Length of strings, equals and null term 
+  memcpy(env->contents, name, name_len); // Copy new name
+  env->contents[name_len] = '='; // Copy equals sign
+  memcpy(env->contents + name_len + 1, value, value_len + 1); // Copy value and null term
   return; 
 }
 
+/**
+ * @brief Adds a new variable to the end of the list and to the index. 
+ * 
+ * @param list The list of environment variables, index_prepare must have been called
+ * @param name The name of the variable, the list takes ownership of it
+ * @param contents The NAME=value string, the list takes ownership of it
+ */
+static void add_env(struct list_head *list, char *name, char *contents) {
+  struct environment *env = malloc(sizeof(struct environment)); // Allocate space for a new environment variable
+  env->name = name; 
+  env->contents = contents; 
+  env->hash = hash_name(name); 
+  list_add_tail(&env->list, list); // Add environment to tail, keeps insertion order
+  index_insert(env); 
+}
+
 /**
  * @brief Set an environment variable.
  * 
@@ -43,32 +233,22 @@ static void set_env_update_contents(struct environment *env, char *name, char *v
  * @return int Returns 0 upon success, returns -1 if unsuccessful/error ocurred
  */
 int set_env(struct list_head *list, char *name, char *value) {
-  struct environment *env; // Environment to search through
-  struct list_head *curr; // Current node in list
-  curr = list; // Set current
-
-  // First, search through list_head to find if environment variable exists. 
-
-  // Iterate through list until we reach the beginning again. 
-  for (curr = curr->next; curr != list; curr = curr->next) {
-    env = list_entry(curr, struct environment, list); // Update environment 
-    // If the environment name matches the name we are searching for 
-    if (strcmp(env->name, name) == 0) {
-      // Update contents
-      free(env->contents); // Free old contents
-      set_env_update_contents(env, name, value, list); 
-      return 0;  // Return 0 for success
-    }
-  }
-
-  // If environment variable was not found in list of environment variables, add it!
+  index_prepare(list); 
+  struct environment *env = find_env(list, name); 
 
-  env = malloc(sizeof(struct environment)); // Allocate space for a new environment variable
-  env->name = strdup(name); // Add name to environment variable
-  set_env_update_contents(env, name, value, list); 
-  list_add_tail(&env->list, list); // Add environment to tail
+  env_array_invalidate(list); 
 
+  // If the variable already exists, update its contents in place
+  if (env != NULL) {
+    free(env->contents); // Free old contents
+    set_env_update_contents(env, name, value, list); 
+    return 0;  // Return 0 for success
+  }
 
+  // If environment variable was not found in list of environment variables, add it!
+  struct environment new_env; 
+  set_env_update_contents(&new_env, name, value, list); 
+  add_env(list, strdup(name), new_env.contents); 
   return 0; // Return 0 for success
 }
 
@@ -80,22 +260,20 @@ int set_env(struct list_head *list, char *name, char *value) {
  * @return int Returns 0 upon success, returns -1 if unsuccessful/error ocurred
  */
 int unset_env(struct list_head *list_env, char *name) {
-    struct environment *entry; // Environment to search through
-    struct list_head *curr; // Current node in list
-
-    curr = list_env; // Update node 
-    // Iterate through list until we reach the beginning again. 
-    for (curr = curr->next; curr != list_env; curr = curr->next) {
-        entry = list_entry(curr, struct environment, list); // Update environment 
-        // If environment name matches name we are searching through 
-        if (strcmp(entry->name, name) == 0) {
-            list_del(&entry->list); // Delete node from list
-            free(entry->name); // Free name 
-            free(entry->contents); // Free contents
-            free(entry); // Free node 
-            return 0; // Return 0 for success
-        }
-    }
+  index_prepare(list_env); 
+  unsigned long slot = index_find(name, hash_name(name)); 
+  if (slot == env_index.capacity) {
+    return 0; // Removing a variable that is not set is not an error
+  }
+
+  env_array_invalidate(list_env); 
+  struct environment *entry = env_index.slots[slot]; 
+  env_index.slots[slot] = INDEX_TOMBSTONE; // Keep probe chains through this slot intact
+  list_del(&entry->list); // Delete node from list
+  free(entry->name); // Free name 
+  free(entry->contents); // Free contents
+  free(entry); // Free node 
+  return 0; // Return 0 for success
 }
 
 /**
@@ -105,12 +283,7 @@ int unset_env(struct list_head *list_env, char *name) {
  * @return char* The environment variable name. 
  */
 static char * get_env_variable_name(char const *contents) {
-  int len = strlen(contents) + 1; // Length of string + null term
-  char *new_contents = malloc(len * sizeof(char)); // Allocate space for new contents
-  strncpy(new_contents, contents, len); // Copy contents to new contents
-  char *name; // New variable to hold name of environment variable 
-  name = strtok(new_contents, "="); // Strtok at "=" to get name
-  return name; // Return name
+  return strndup(contents, strcspn(contents, "=")); // Everything before the equals sign
 }
 
 /**
@@ -136,21 +309,11 @@ static char * get_env_variable_value(char *contents) {
  * @return char* The contents of the envirnment variable or NULL if the environment variable is not there 
  */
 char * get_env(struct list_head *list, char *name) {
-  struct environment *env; // Environnent to look through
-  struct list_head *curr; // Current node
-
-  curr = list->next; // Update node
-  // Iterate through list until we reach the beginning again
-  while (curr != list) {
-    env = list_entry(curr, struct environment, list); // Update environment 
-    curr = curr->next;
-    // If the env name matches the name passed, return the contents
-    if (!strcmp(env->name, name)) { 
-      //return get_env_variable_value(env->contents); 
-       return env->contents;
-    }
+  struct environment *env = find_env(list, name); 
+  if (env == NULL) {
+    return NULL; // If we did not find the environment in the list
   }
-  return NULL; // If we did not find the environment in the list
+  return env->contents;
 }
 
 /**
@@ -162,21 +325,11 @@ char * get_env(struct list_head *list, char *name) {
  * @return char* The value of the envirnment variable or NULL if the environment variable is not there 
  */
 char * get_env_value(struct list_head *list, char *name) {
-  struct environment *env; // Environment to look through 
-  struct list_head *curr; // Current node
-
-  curr = list->next; // Update node
-  // Iterate through list until we reach the beginning again
-  while (curr != list) {
-    env = list_entry(curr, struct environment, list); // Update environment 
-    curr = curr->next; 
-    // If the env name matches the name passed, return the contents
-    if (!strcmp(env->name, name)) { 
-      // Return the value of the variable
-      return get_env_variable_value(env->contents); 
-    }
+  struct environment *env = find_env(list, name); 
+  if (env == NULL) {
+    return NULL; // If we didn't find the environment in the list
   }
-  return NULL; // If we didn't find the environment in the list
+  return get_env_variable_value(env->contents); // Return the value of the variable
 }
 
 /**
@@ -200,6 +353,13 @@ void free_env_array(char **envp, int len) {
  */
 void clear_list_env(struct list_head *list) {
   struct environment *entry; // Environment to potentially clear
+
+  // The index would point at freed variables, drop it
+  if (env_index.list == list) {
+    free(env_index.slots); 
+    memset(&env_index, 0, sizeof(env_index)); 
+  }
+  env_array_invalidate(list); 
   // Iterate through list while it is not empty
   while (!list_empty(list)) {
     entry = list_entry(list->next, struct environment, list); // Update environment 
@@ -216,6 +376,16 @@ void clear_list_env(struct list_head *list) {
  * @param list_envp The list_head of the list that is being displayed
  */
 void display_env_list(struct list_head *envp_list) {
+  write_env_list(envp_list, stdout); 
+}
+
+/**
+ * @brief Take in the envp list and prints it to a stream.
+ * 
+ * @param list_envp The list_head of the list that is being printed
+ * @param stream Where the list is printed
+ */
+void write_env_list(struct list_head *envp_list, FILE *stream) {
   struct list_head *start = envp_list->next; // Start at the first node after the head
   struct list_head *curr; // Tracks current node during traversal
   struct environment *entry; // Current nodes struct with contents
@@ -224,7 +394,7 @@ void display_env_list(struct list_head *envp_list) {
   for (curr = envp_list->next; curr->next != start; curr = curr->next)
   {
     entry = list_entry(curr, struct environment, list); // Update entry 
-    printf("%s\n", entry->contents); // Print the contents of entry 
+    fprintf(stream, "%s\n", entry->contents); // Print the contents of entry 
   }
 }
 
@@ -274,13 +444,53 @@ char ** make_env_array(struct list_head *list) {
  */
 void make_env_list(struct list_head *list, char **envp) {
   int i = 0; // Used to keep track of which environment we are on
+  env_array_invalidate(list); 
   // Iterate through 2D array until we reach null (end of 2D array)
   while (envp[i] != NULL) { 
-    struct environment *env = malloc(sizeof(struct environment)); // Update environment
-    env->contents = strdup(envp[i]); // Copy contents
-    char *name = get_env_variable_name(env->contents); // Get name 
-    env->name = name; // Add name to list
-    list_add(&env->list, list); // Add to tail
+    char *name = get_env_variable_name(envp[i]); // Get name 
+    index_prepare(list); 
+    struct environment *env = find_env(list, name); 
+    if (env != NULL) { // A repeated name replaces the earlier one
+      free(env->contents); 
+      env->contents = strdup(envp[i]); 
+      free(name); 
+    } else {
+      add_env(list, name, strdup(envp[i])); // Add to tail
+    }
     i++; // Move on to next node
   }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Gets the environment array passed to exec. Unlike make_env_array nothing is 
+ * copied, the array is cached and points into the list, so it must not be freed or 
+ * modified and is only valid until the next set_env, unset_env or clear_list_env. 
+ * 
+ * @param list list_head to make array from.
+ * @return char** array of environment variables.
+ */
+char ** get_env_array(struct list_head *list) {
+  if (env_array.list == list && !env_array.dirty) {
+    return env_array.envp; 
+  }
+
+  int list_len = getListLength(list); 
+  if (env_array.list != list || env_array.capacity < list_len + 1) {
+    free(env_array.envp); 
+    env_array.capacity = (list_len + 1) * 2; // Room to grow without reallocating
+    env_array.envp = malloc(env_array.capacity * sizeof(char *)); 
+  }
+
+  struct list_head *curr; 
+  int i = 0; 
+  for (curr = list->next; curr != list; curr = curr->next) {
+    env_array.envp[i++] = list_entry(curr, struct environment, list)->contents; 
+  }
+  env_array.envp[i] = NULL; 
+  if (tracing()) {
+    trace_env_copied(i); 
+  }
+  env_array.list = list; 
+  env_array.dirty = 0; 
+  return env_array.envp; 
+}
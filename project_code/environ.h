@@ -1,6 +1,8 @@
 #ifndef ENVIRON_H
 #define ENVIRON_H
 
+#include <stdio.h>
+
 #include "list.h"
 
 /**
@@ -8,12 +10,14 @@
  * 
  * @param name char* name of the environment variable (ex. NAME)
  * @param contents char* the convents of envp[i]
- * @param list_head list, part of a list 
+ * @param hash unsigned long hash of name, used by the lookup index
+ * @param list_head list, part of a list kept in the order variables were added
  * 
  */
 struct environment {
     char *name; 
     char *contents; 
+    unsigned long hash; 
     struct list_head list; 
 };
 
@@ -21,8 +25,10 @@ int set_env(struct list_head *list, char *name, char *value);
 int unset_env(struct list_head *list, char *name); 
 void show_env(char **envp); 
 void display_env_list(struct list_head *list); 
+void write_env_list(struct list_head *list, FILE *stream); 
 void display_env_array(char **envp); 
 char ** make_env_array(struct list_head *list); 
+char ** get_env_array(struct list_head *list); 
 void make_env_list(struct list_head *list, char **envp);  
 void free_env_array(char **envp, int len); 
 char * get_env(struct list_head *list, char *name); 
@@ -19,12 +19,22 @@
 #define ERROR_GETENV_INVALID "Error - getenv unknown variable %s\n" // variable name
 #define ERROR_QUEUE_ARG  "Error - queue requires at least two arguments\n"
 #define ERROR_OUTPUT_ARG "Error - output takes one argument\n"
-#define ERROR_OUTPUT_QUEUED   "Error - task %d is still queued." // task # 0, 1, ...
+#define ERROR_OUTPUT_QUEUED   "Error - task %d is still queued.\n" // task # 0, 1, ...
 #define ERROR_OUTPUT_RUNNING "Error - task %d is still running\n" // task # 
+#define ERROR_OUTPUT_CANCELED "Error - task %d was canceled\n" // task #
+#define ERROR_TASK_INVALID "Error - there is no task %s\n" // task argument
+#define ERROR_TASK_INVALID_NUM "Error - there is no task %d\n" // task #
+#define ERROR_QUEUE_AFTER "Error - queue --after takes task numbers separated by commas : %s\n" // argument
+#define MSG_QUEUED "%d is queued\n" // task #
+#define MSG_QUEUE_DEPENDENCY "%d is canceled, task %d did not complete\n" // task #, task # it waited for
+#define ERROR_QUEUE_START "Error - could not start task %d : %s\n" // task #, strerror(errno)
+#define ERROR_JOBS_FORKED "Error - %s only works in the shell itself, not in a copy of it such as an & line\n" // command
 #define ERROR_STATUS_ARG "Error - status takes 0 arguments\n"
 #define MSG_STATUS_QUEUED "%d - is queued\n" // task #
+#define MSG_STATUS_WAITING "%d - is queued after task %d\n" // task #, task # it is waiting for
 #define MSG_STATUS_RUNNING "%d is running as pid %d\n" // task #
 #define MSG_STATUS_COMPLETE "%d is complete\n" // task #
+#define MSG_STATUS_CANCELED "%d is canceled\n" // task #
 #define ERROR_CANCEL_ARG "Error - cancel takes one argument\n"
 #define MSG_CANCEL_OK "%d is canceled\n" // task #
 #define MSG_CANCEL_KILL "%d sending kill signal to pid %d\n" // task #, pid_t
@@ -38,7 +48,48 @@
 // strerror(errno)
 #define ERROR_EXEC_FAILED "Error - could not execute : %s\n" 
 // strerror(errno)
+#define ERROR_CMD_NOT_FOUND "Error - command not found : %s\n" // command name
+#define ERROR_HASH_NOT_FOUND "Error - hash %s not found\n" // command name
 #define ERROR_INVALID_CMD "Error could not execute : %s\n" 
 // strerror(errno)
 #define ERROR_INVALID_CMDLINE "Error - malformed command line.\n"
+#define ERROR_SCRIPT_OPEN "Error - could not open script %s : %s\n" 
+// script name, strerror(errno)
+#define ERROR_PRINTF_ARG "Error - printf takes a format and arguments\n"
+#define ERROR_PRINTF_NUMBER "Error - printf expected a number : %s\n" // argument
+#define ERROR_PRINTF_RANGE "Error - printf number out of range : %s\n" // argument
+#define ERROR_PRINTF_CONVERSION "Error - printf invalid conversion : %s\n" // rest of the format
+#define ERROR_TEST "Error - test %s : %s\n" // what is wrong, argument
+#define ERROR_COPY_OPEN "Error - could not open %s : %s\n" // file name, strerror(errno)
+#define ERROR_COPY_FAILED "Error - could not copy %s : %s\n" // file name, strerror(errno)
+#define MSG_TIME_STAGE "%d %s : real %.3fs user %.3fs sys %.3fs maxrss %ldKB ctxsw %ld/%ld faults %ld/%ld status %d\n" 
+// stage #, command, seconds x3, maxrss, voluntary/involuntary switches, minor/major faults, exit code
+#define MSG_TIME_TOTAL "total : real %.3fs user %.3fs sys %.3fs maxrss %ldKB\n" // seconds x3, largest maxrss
+#define MSG_TIME_STAGE_KEYS "stage=%d command=%s real=%.6f user=%.6f sys=%.6f maxrss_kb=%ld vcsw=%ld ivcsw=%ld minflt=%ld majflt=%ld status=%d\n" 
+// same as MSG_TIME_STAGE
+#define MSG_TIME_TOTAL_KEYS "stage=total real=%.6f user=%.6f sys=%.6f maxrss_kb=%ld\n" // same as MSG_TIME_TOTAL
+#define ERROR_TRACE_OPEN "Error - could not open trace file %s : %s\n" // path, strerror(errno)
+#define ERROR_HEREDOC "Error - could not make here-document : %s\n" // strerror(errno)
+#define ERROR_HEREDOC_EOF "Error - here-document ended by end of file, wanted %s\n" // delimiter
+#define ERROR_PROCESS_SUB "Error - could not start process substitution : %s\n" // strerror(errno)
+#define ERROR_WAIT_INVALID "Error - there is no background job %s\n" // job argument
+#define MSG_BACKGROUND "[%d] %d\n" // job id, pid
+#define ERROR_BACKGROUND "Error - could not start background job : %s\n" // strerror(errno)
+#define ERROR_PARALLEL_USAGE "Usage: parallel [-j jobs] [-k] [-0] command [args] [::: inputs]\n"
+#define ERROR_PARALLEL_INPUT "Error - parallel could not read inputs : %s\n" // strerror(errno)
+#define ERROR_PARALLEL_START "Error - parallel could not start %s : %s\n" // command name, strerror(errno)
+#define ERROR_PIPEPART_USAGE "Usage: pipepart [-j copies] command [args] < file [| command...]\n"
+#define ERROR_PIPEPART_START "Error - pipepart could not start a copy : %s\n" // strerror(errno)
+#define ERROR_CACHE_ARG "Error - cache takes a command, stats or purge\n"
+#define ERROR_CACHE_DIR "Error - cache has nowhere to keep results, set SUSH_CACHE_DIR or HOME\n"
+#define MSG_CACHE_STATS "%d entries, %lld of %lld bytes, %d hits and %d misses : %s\n" 
+// entries, bytes used, byte limit, hits, misses, directory
+#define ERROR_WORKER_ARG "Error - worker takes no arguments, or add and a socket\n"
+#define ERROR_WORKER_CONNECT "Error - could not reach worker %s : %s\n" // socket path, strerror(errno)
+#define ERROR_WORKER_SOCKET "Error - worker could not listen on %s : %s\n" // socket path, strerror(errno)
+#define ERROR_WORKER_CWD "Error - worker could not change to %s : %s\n" // directory, strerror(errno)
+#define MSG_WORKER "%s is running %d of %d jobs\n" // socket path, running jobs, slots
+#define MSG_STATUS_REMOTE "%d is running on worker %s\n" // task #, socket path
+#define MSG_CANCEL_REMOTE "%d asking worker %s to kill it\n" // task #, socket path
+#define ERROR_USAGE "Usage: sush [script | -c command | --worker socket]\n"
 #endif
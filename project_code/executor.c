@@ -19,174 +19,835 @@
 #include <fcntl.h>
 #include <stdlib.h> // for memory allocation
 #include <stdio.h> // for input/output
+#include <signal.h> // for SIGPIPE
+#include <string.h> // for strerror
+#include <spawn.h> // for posix_spawn
+#include <pthread.h> // for builtin stages
+#include <poll.h> // for reaping stages as they exit
+#include <sys/pidfd.h> // for pidfd_open
+#include <sys/resource.h> // for wait4 and getrusage
+#include <time.h> // for clock_gettime
 
 #include "executor.h"
+#include "environ.h"
+#include "pathcache.h"
 #include "error.h"
+#include "internal.h"
+#include "timing.h"
+#include "trace.h"
+#include "heredoc.h"
 
-//Defined function for error printing
-#define ERROR_CHECK_MSG(error, subcmd_file) ({ \
-if (access(subcmd_file, F_OK) != 0) {          \
-  fprintf(stderr, error, strerror(errno));     \
-  return -1;                                   \
-  }                                            \
-})                                             \
+#define SCRIPT_SHELL "/bin/sh" // Runs files that have no #! line
+
+/**
+ * @brief An internal command running as a stage of a pipeline in a shell thread. 
+ * 
+ * @param thread The thread running the command
+ * @param subcmd The command
+ * @param list_env The list of environment variables
+ * @param fds The stage's input and output, the thread closes them when it is done
+ * @param started 1 once the thread has been created
+ */
+struct builtin_stage {
+  pthread_t thread; 
+  struct subcommand *subcmd; 
+  struct list_head *list_env; 
+  int fds[2]; 
+  int started; 
+}; 
+
+static enum Launcher launcher = LAUNCH_SPAWN; // How child processes are started
+
+/**
+ * @brief Chooses how child processes are started. LAUNCH_SPAWN uses posix_spawn, 
+ * which shares the shell's memory with the child until it execs, so it costs the 
+ * same no matter how big the shell is. LAUNCH_FORK uses fork, which copies the 
+ * page tables of the whole shell. 
+ * 
+ * @param new_launcher The way children are started from now on
+ */
+void set_launcher(enum Launcher new_launcher) {
+  launcher = new_launcher; 
+}
+
+/**
+ * @brief Builds the args that run a file the kernel could not exec, one without a #! 
+ * line, as a script with /bin/sh the way execvp does. 
+ * 
+ * @param command Full path of the file 
+ * @param args The args the file was run with 
+ * @return char** /bin/sh, the file and the rest of args, freed by the caller 
+ */
+static char **script_args(char *command, char *const *args) {
+  int num_args = 0; 
+  while (args[num_args] != NULL) {
+    num_args++; 
+  }
+  char **sh_args = malloc((num_args + 2) * sizeof(char *)); 
+  sh_args[0] = SCRIPT_SHELL; 
+  sh_args[1] = command; 
+  for (int i = 1; i <= num_args; i++) { // Copies the NULL too
+    sh_args[i + 1] = args[i]; 
+  }
+  return sh_args; 
+}
+
+/**
+ * @brief Replaces the process with a file, running it with /bin/sh if it has no #! line. 
+ * Only returns if it could not be run. 
+ * 
+ * @param command Full path of the file 
+ * @param args The list of args sent to exec 
+ * @param env Array of environment variables
+ */
+static void exec_file(char *command, char *const *args, char **env) {
+  execve(command, args, env); 
+  if (errno == ENOEXEC) {
+    char **sh_args = script_args(command, args); 
+    execve(SCRIPT_SHELL, sh_args, env); 
+    free(sh_args); 
+  }
+}
 
 /**
  * @brief Handles the execution of the child process 
  * @author Hannah Moats 
- * @param command char* Type of command being executed 
+ * @param command char* Full path of the command being executed, found by the parent 
  * @param args char* const The list of args sent to exec 
  * @param env char** array of environment variables
  */
 static void handleChildInExecutor(char *command, char *const *args, char **env) {
-  pid_t pid2 = execvpe(command, args, env); // Execute command 
-  fprintf(stderr, ERROR_EXEC_FAILED, strerror(errno)); // Should only be reaches when error happens with execvpe
+  exec_file(command, args, env); // Execute command 
+  fprintf(stderr, ERROR_EXEC_FAILED, strerror(errno)); // Should only be reaches when error happens with execve
   exit(1); // Exit with error 
 }
 
 /**
- * @brief Handles the execution of the parent process 
+ * @brief Starts a command with fork and exec. 
+ * 
+ * @param command Full path of the command being executed 
+ * @param args The list of args sent to exec 
+ * @param env Array of environment variables
+ * @param fds The file descriptors that become the child's stdin, stdout and stderr
+ * @param subs Process substitutions whose pipes the child keeps open
+ * @param num_subs The number of process substitutions
+ * @return pid_t The process id of the child, or -1 if it could not be started
+ */
+static pid_t launch_with_fork(char *command, char **args, char **env, int fds[3], struct process_sub *subs, int num_subs) {
+  pid_t pid = fork(); 
+
+  if (pid == 0) { // Child process 
+    sigset_t empty; 
+    sigemptyset(&empty); 
+    sigprocmask(SIG_SETMASK, &empty, NULL); // Threads that launch jobs block signals
+    signal(SIGPIPE, SIG_DFL); // Upstream stages must die when their reader does
+    for (int i = 0; i < 3; i++) {
+      if (fds[i] != i) {
+        dup2(fds[i], i); 
+      }
+    }
+    for (int i = 0; i < num_subs; i++) {
+      fcntl(subs[i].fd, F_SETFD, 0); // Passed by its /dev/fd path, so it must survive exec
+    }
+    handleChildInExecutor(command, args, env); 
+  }
+  return pid; 
+}
+
+/**
+ * @brief Starts a command with posix_spawn. The file descriptor plumbing is done as 
+ * file actions, every other descriptor the shell opened is close on exec. 
+ * 
+ * @param command Full path of the command being executed 
+ * @param args The list of args sent to exec 
+ * @param env Array of environment variables
+ * @param fds The file descriptors that become the child's stdin, stdout and stderr
+ * @param subs Process substitutions whose pipes the child keeps open
+ * @param num_subs The number of process substitutions
+ * @return pid_t The process id of the child, or -1 if it could not be started
+ */
+static pid_t launch_with_spawn(char *command, char **args, char **env, int fds[3], struct process_sub *subs, int num_subs) {
+  posix_spawn_file_actions_t actions; 
+  posix_spawnattr_t attr; 
+  sigset_t signals; 
+  pid_t pid; 
+
+  posix_spawn_file_actions_init(&actions); 
+  for (int i = 0; i < 3; i++) {
+    if (fds[i] != i) {
+      posix_spawn_file_actions_adddup2(&actions, fds[i], i); 
+    }
+  }
+  for (int i = 0; i < num_subs; i++) { // Duplicating a descriptor onto itself clears close on exec
+    posix_spawn_file_actions_adddup2(&actions, subs[i].fd, subs[i].fd); 
+  }
+
+  posix_spawnattr_init(&attr); 
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK); 
+  sigemptyset(&signals); 
+  posix_spawnattr_setsigmask(&attr, &signals); // Threads that launch jobs block signals
+  sigaddset(&signals, SIGPIPE); 
+  posix_spawnattr_setsigdefault(&attr, &signals); // Upstream stages must die when their reader does
+
+  int error = posix_spawn(&pid, command, &actions, &attr, args, env); 
+  if (error == ENOEXEC) { // No #! line, posix_spawn does not fall back to /bin/sh itself
+    char **sh_args = script_args(command, args); 
+    error = posix_spawn(&pid, SCRIPT_SHELL, &actions, &attr, sh_args, env); 
+    free(sh_args); 
+  }
+  posix_spawn_file_actions_destroy(&actions); 
+  posix_spawnattr_destroy(&attr); 
+
+  if (error != 0) {
+    fprintf(stderr, ERROR_EXEC_FAILED, strerror(error)); 
+    errno = error; 
+    return -1; 
+  }
+  return pid; 
+}
+
+/**
+ * @brief Starts a command with whichever launcher was chosen at startup. 
+ * 
+ * @param command Full path of the command being executed 
+ * @param args The list of args sent to exec 
+ * @param env Array of environment variables
+ * @param fds The file descriptors that become the child's stdin, stdout and stderr
+ * @param subs Process substitutions whose pipes the child keeps open
+ * @param num_subs The number of process substitutions
+ * @return pid_t The process id of the child, or -1 if it could not be started
+ */
+static pid_t launch(char *command, char **args, char **env, int fds[3], struct process_sub *subs, int num_subs) {
+  if (launcher == LAUNCH_FORK) {
+    return launch_with_fork(command, args, env, fds, subs, num_subs); 
+  }
+  return launch_with_spawn(command, args, env, fds, subs, num_subs); 
+}
+
+/**
+ * @brief Converts a status returned by waitpid into a shell exit code. A command 
+ * killed by a signal reports 128 plus the signal number, like other shells. 
+ * 
+ * @param status The status filled in by waitpid
+ * @return int The exit code of the process 
+ */
+int exit_code_from_status(int status) {
+  if (WIFEXITED(status)) {
+    return WEXITSTATUS(status); 
+  } else if (WIFSIGNALED(status)) {
+    return 128 + WTERMSIG(status); 
+  }
+  return 1; 
+}
+
+/**
+ * @brief Handles the execution of the parent process, waits for the child and 
+ * records its exit code, when it finished and what it used in the subcommand. 
  * @author Hannah Moats
- * @param pid The process id
- * @param option The option passed to waitpid 
+ * @param subcmd The subcommand whose process is being waited on 
  */
-static void handleParentInExecutor(pid_t pid, int option) {
+static void handleParentInExecutor(struct subcommand *subcmd) {
   int status; 
-  waitpid(pid, &status, option); // Wait for child to die
-  // printf("Child exited: %d\n", status);
+  while (wait4(subcmd->pid, &status, 0, &subcmd->usage.rusage) == -1) { // Wait for child to die
+    if (errno != EINTR) {
+      subcmd->status = 1; 
+      return; 
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &subcmd->usage.end); 
+  subcmd->status = exit_code_from_status(status); 
 }
 
 /**
- * @brief Handles getting input from a file, outputting to a file for commands. 
+ * @brief Waits for every forked stage of a pipeline, reaping each one as soon as it 
+ * exits so its end time is right even when a later stage finishes first. Each child 
+ * is watched with a pidfd, which only ever reports that child, so queued jobs the 
+ * shell started are left alone. Without pidfds the stages are reaped in order. 
+ * 
+ * @param list_commands The stages of the pipeline
+ * @param subcommand_count The number of stages
+ */
+static void reap_stages(struct list_head *list_commands, int subcommand_count) {
+  struct pollfd *polls = calloc(subcommand_count, sizeof(struct pollfd)); 
+  struct subcommand **waiting = calloc(subcommand_count, sizeof(struct subcommand *)); 
+  struct list_head *curr; 
+  int num_waiting = 0; 
+
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    struct subcommand *entry = list_entry(curr, struct subcommand, list); 
+    if (entry->pid <= 0) {
+      continue; 
+    }
+    int pidfd = pidfd_open(entry->pid, 0); 
+    if (pidfd == -1) {
+      handleParentInExecutor(entry); 
+      continue; 
+    }
+    polls[num_waiting].fd = pidfd; 
+    polls[num_waiting].events = POLLIN; 
+    waiting[num_waiting++] = entry; 
+  }
+
+  int left = num_waiting; 
+  while (left > 0) {
+    if (poll(polls, num_waiting, -1) == -1) {
+      if (errno == EINTR) {
+        continue; 
+      }
+      break; 
+    }
+    for (int i = 0; i < num_waiting; i++) {
+      if (polls[i].fd >= 0 && polls[i].revents != 0) {
+        handleParentInExecutor(waiting[i]); 
+        close(polls[i].fd); 
+        polls[i].fd = -1; // poll skips it from now on
+        left--; 
+      }
+    }
+  }
+
+  for (int i = 0; i < num_waiting; i++) { // Only left if poll failed
+    if (polls[i].fd >= 0) {
+      handleParentInExecutor(waiting[i]); 
+      close(polls[i].fd); 
+    }
+  }
+  free(polls); 
+  free(waiting); 
+}
+
+/**
+ * @brief Opens the files a subcommand redirects its input and output to. The files 
+ * are opened by the shell before anything is started, so every launcher only has to 
+ * move descriptors around. A here-document or here-string is made into a descriptor 
+ * the same way. 
  *
  * @param subcmd The command who's input and output is being handled. 
+ * @param fds Set to the opened input and output, left alone if there is no redirect
  * @return int Returns -1 for error, 0 no error
  */
-static int handle_input_output(struct subcommand *subcmd) {
+int open_redirect_files(struct subcommand *subcmd, int fds[2]) {
+  if (subcmd->input_type == REDIRECT_INPUT) {
+    fds[0] = open(subcmd->input, O_RDONLY | O_CLOEXEC); 
+    if (fds[0] == -1) {
+      fprintf(stderr, ERROR_EXEC_INFILE, strerror(errno)); 
+      return -1; 
+    }
+  } else if (subcmd->input_type == REDIRECT_HEREDOC || subcmd->input_type == REDIRECT_HERESTRING) {
+    fds[0] = open_heredoc(subcmd); 
+    if (fds[0] == -1) {
+      fprintf(stderr, ERROR_HEREDOC, strerror(errno)); 
+      return -1; 
+    }
+  }
+
   // If subcmd->output is anything other than stdout (default)
   if (strcmp(subcmd->output, "stdout") != 0) {
-    const char *filename = subcmd->output; // Get filename
-    int fd = 0; // File descriptor 
-
-    // If type is truncate, open file with trucate flags
-    if (subcmd->type == REDIRECT_OUTPUT_TRUNCATE) {
-      fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0777); 
-       ERROR_CHECK_MSG(ERROR_EXEC_OUTFILE, subcmd->output);
-    // If type is append, open file with append flags
-    } else if (subcmd->type == REDIRECT_OUTPUT_APPEND) {
-      fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0777); 
-      ERROR_CHECK_MSG(ERROR_EXEC_APPEND, subcmd->output);
-    }
-    close(STDOUT_FILENO); // Close STDOUT
-    dup2(fd, STDOUT_FILENO); // Connect FD and STDOUT 
-
-  // If subcmd->input is anything other than "stdin" (default) 
-  } if (strcmp(subcmd->input, "stdin") != 0) {
-    const char *filename = subcmd->input; // Get filename
-    FILE *file;
-    file = fopen(filename, "r"); // File descriptor, open file read only
-    int fd = fileno(file);  
-
-    close(STDIN_FILENO); // Close STDIN
-    dup2(fd, STDIN_FILENO); // Connect FD and STDIN
-    close(fd);
+    if (subcmd->type == REDIRECT_OUTPUT_APPEND) {
+      fds[1] = open(subcmd->output, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0777); 
+      if (fds[1] == -1) {
+        fprintf(stderr, ERROR_EXEC_APPEND, strerror(errno)); 
+        return -1; 
+      }
+    } else {
+      fds[1] = open(subcmd->output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0777); 
+      if (fds[1] == -1) {
+        fprintf(stderr, ERROR_EXEC_OUTFILE, strerror(errno)); 
+        return -1; 
+      }
+    }
   }
   return 0; 
 }
 
 /**
- * @brief Checks if the input file is in created. 
+ * @brief Closes a stage's input and output if they are not the shell's own. 
  * 
- * @param subcmd The subcommand that is being evaluated. 
- * @return int Returns -1 if the file is not vlaid, else returns 0. 
+ * @param fds The stage's input and output, set to the shell's own once closed
  */
-static int check_validity_of_files(struct subcommand *subcmd) { 
-  char *input = subcmd->input; 
-  if (strcmp(input, "stdin") != 0) {
-    ERROR_CHECK_MSG(ERROR_EXEC_INFILE, subcmd->input);
+static void close_stage_fds(int fds[2]) {
+  if (fds[0] != STDIN_FILENO) {
+    close(fds[0]); 
+    fds[0] = STDIN_FILENO; 
   }
-  return 0; 
+  if (fds[1] != STDOUT_FILENO) {
+    close(fds[1]); 
+    fds[1] = STDOUT_FILENO; 
+  }
+}
+
+/**
+ * @brief Runs an internal command in its own thread. SIGPIPE is blocked in the 
+ * thread, so writing to a pipe whose reader has exited fails with EPIPE instead of 
+ * killing the shell. The output is collected and written when the command is done. 
+ * What the thread used is recorded the same way a child's is. 
+ * 
+ * @param arg The builtin_stage being run
+ * @return void* Always NULL, the exit code is stored in the subcommand
+ */
+static void *builtin_thread(void *arg) {
+  struct builtin_stage *stage = arg; 
+  struct stage_usage *usage = &stage->subcmd->usage; 
+  struct rusage before; 
+  sigset_t signals; 
+  sigemptyset(&signals); 
+  sigaddset(&signals, SIGPIPE); 
+  pthread_sigmask(SIG_BLOCK, &signals, NULL); 
+
+  getrusage(RUSAGE_THREAD, &before); 
+  stage->subcmd->status = run_internal(stage->subcmd, stage->list_env, stage->fds[0], stage->fds[1]); 
+  close_stage_fds(stage->fds); 
+  clock_gettime(CLOCK_MONOTONIC, &usage->end); 
+  getrusage(RUSAGE_THREAD, &usage->rusage); 
+  rusage_since(&usage->rusage, &before); 
+  return NULL; 
 }
 
 /**
- * @brief Executes the command, given the type of command and the argument array 
+ * @brief Starts an internal command that changes the shell's state in a forked 
+ * child, so it only changes the child's state, like a pipeline stage in other shells. 
  * 
- * @param command The type of command that is being executed, Ex. /bin/ls
- * @param args The array of args that exec() takes in
+ * @param subcmd The command
+ * @param list_env The list of environment variables
+ * @param fds The file descriptors that become the child's stdin and stdout
+ * @return pid_t The process id of the child, or -1 if it could not be started
  */
-static void execute(char *command, char *const *args, struct subcommand *subcmd, char **env) { 
+static pid_t fork_builtin(struct subcommand *subcmd, struct list_head *list_env, int fds[2]) {
+  fflush(NULL); // Nothing buffered in the shell may be written twice
   pid_t pid = fork(); 
 
   if (pid == 0) { // Child process 
-      // if there is output
-      handle_input_output(subcmd);
-      handleChildInExecutor(command, subcmd->exec_args, env);
-  } else { // Parent process 
-    handleParentInExecutor(pid, 0); 
+    sigset_t empty; 
+    sigemptyset(&empty); 
+    sigprocmask(SIG_SETMASK, &empty, NULL); 
+    signal(SIGPIPE, SIG_DFL); 
+    for (int i = 0; i < 2; i++) {
+      if (fds[i] != i) {
+        dup2(fds[i], i); 
+      }
+    }
+    _exit(run_internal(subcmd, list_env, STDIN_FILENO, STDOUT_FILENO)); 
+  }
+  return pid; 
+}
+
+/**
+ * @brief Runs a parsed command line in a forked copy of the shell. A lone command 
+ * replaces the copy, anything else is run like any command line. 
+ * 
+ * @param subcommand_count The number of subcommands in list_commands
+ * @param list_commands The subcommands of the line
+ * @param list_env The list of environment variables
+ * @return int The exit code of the command line
+ */
+int run_forked_line(int subcommand_count, struct list_head *list_commands, struct list_head *list_env) {
+  struct subcommand *first = list_entry(list_commands->next, struct subcommand, list); 
+  int status = 0; 
+
+  if (handle_internal(list_commands, list_env, &status) == 1) {
+    if (subcommand_count == 1 && first->num_subs == 0 && internal_stage(first->exec_args) == NOT_INTERNAL) {
+      status = exec_command(list_commands, list_env); // Only returns on failure
+    } else {
+      status = run_command(subcommand_count, list_commands, list_env); 
+    }
   }
+  fflush(NULL); 
+  return status; 
 }
 
+/**
+ * @brief Runs the command of a process substitution in a forked copy of the shell. 
+ * 
+ * @param command The command line
+ * @param list_env The list of environment variables
+ * @return int The exit code of the command line
+ */
+static int run_substitution(char *command, struct list_head *list_env) {
+  struct arena arena = ARENA_INIT; 
+  commandline cmdline = { .arena = &arena }; 
+  cmdline.line = arena_strdup(&arena, command); // The command may be in the read only rc cache
+  LIST_HEAD(list_commands); 
+
+  if (parse_commandline(&cmdline, &list_commands) == -1) {
+    return 2; 
+  } else if (cmdline.num == 0) {
+    return 0; 
+  }
+  return run_forked_line(cmdline.num, &list_commands, list_env); 
+}
 
 /**
- * @brief Runs the command typed on the command line including pipes
+ * @brief Starts a command line ending in & in a forked copy of the shell and returns 
+ * without waiting for it. Its input is /dev/null unless it redirects it, so it never 
+ * reads what was meant for the shell. 
  * 
- * @param len The length of the linked listssss
- * @param list_args The linked list of args that are being executed 
+ * @param subcommand_count The number of subcommands in list_commands
+ * @param list_commands The subcommands of the line
+ * @param list_env The list of environment variables
+ * @return pid_t The process id of the copy, or -1 if it could not be started
  */
-void run_command(int subcommand_count, struct list_head *list_commands, char **env) {
-  struct subcommand *entry; 
-  struct list_head *curr;  
+pid_t run_background(int subcommand_count, struct list_head *list_commands, struct list_head *list_env) {
+  fflush(NULL); // Nothing buffered in the shell may be written twice
+  pid_t pid = fork(); 
 
-  // If we have more than one subcommand, then we must use pipes
-  if(subcommand_count>=2){
-    int i=0; // Keep track of what subcommand we are on
-    int prev_output=0; // Temp fd for saving previous pipe output
-    int pipes[2]; // Standard pipes
-
-    // Iterate through entire list until we reach the beggining again. 
-    for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
-      entry = list_entry(curr, struct subcommand, list); // Update entry to look at current subcommand
-      if (check_validity_of_files(entry) == -1) {
-        return; 
+  if (pid == 0) { // Child process 
+    sigset_t empty; 
+    sigemptyset(&empty); 
+    sigprocmask(SIG_SETMASK, &empty, NULL); 
+    signal(SIGPIPE, SIG_DFL); 
+    int null_fd = open("/dev/null", O_RDONLY); 
+    if (null_fd != -1 && null_fd != STDIN_FILENO) {
+      dup2(null_fd, STDIN_FILENO); 
+      close(null_fd); 
+    }
+    _exit(run_forked_line(subcommand_count, list_commands, list_env)); 
+  }
+  return pid; 
+}
+
+/**
+ * @brief Starts every process substitution of a command line, each connected to the 
+ * shell by a pipe. The shell keeps one end and the arg becomes its /dev/fd path, the 
+ * other end is the command's stdout for <(command) or stdin for >(command). They are 
+ * started before the pipeline's own pipes are made, so they never hold those open. 
+ * 
+ * @param list_commands The subcommands of the line
+ * @param list_env The list of environment variables
+ * @return int 0 on success, -1 if one could not be started
+ */
+static int start_substitutions(struct list_head *list_commands, struct list_head *list_env) {
+  struct list_head *curr; 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    struct subcommand *entry = list_entry(curr, struct subcommand, list); 
+    for (int i = 0; i < entry->num_subs; i++) {
+      struct process_sub *sub = &entry->subs[i]; 
+      int child_end = sub->kind == PROCESS_SUB_INPUT ? STDOUT_FILENO : STDIN_FILENO; 
+      int pipes[2]; 
+      if (pipe2(pipes, O_CLOEXEC) == -1) {
+        fprintf(stderr, ERROR_PROCESS_SUB, strerror(errno)); 
+        return -1; 
       }
-      //make pipes
-      if(i<subcommand_count-1){
-        int pipe_code = pipe(pipes);
-
-        // If there was an error creating pipes
-        if(pipe_code < 0){
-          perror("Could not create pipes.\n");
-          return;
+
+      fflush(NULL); // Nothing buffered in the shell may be written twice
+      pid_t pid = fork(); 
+      if (pid == 0) { // Child process 
+        sigset_t empty; 
+        sigemptyset(&empty); 
+        sigprocmask(SIG_SETMASK, &empty, NULL); 
+        signal(SIGPIPE, SIG_DFL); 
+        dup2(pipes[child_end], child_end); 
+        close(pipes[0]); 
+        close(pipes[1]); 
+        struct list_head *other; // Pipes of substitutions started before this one
+        for (other = list_commands->next; other != list_commands; other = other->next) {
+          struct subcommand *started = list_entry(other, struct subcommand, list); 
+          for (int j = 0; j < started->num_subs; j++) {
+            if (started->subs[j].fd != -1) {
+              close(started->subs[j].fd); 
+            }
+          }
         }
+        _exit(run_substitution(sub->command, list_env)); 
       }
-      
-      pid_t pid = fork(); 
 
-      if (pid == 0) { // Child process 
-        if(i<subcommand_count-1){ // All children except the last must write to parent
-          dup2(prev_output, STDIN_FILENO); // read prev_output set by parent (initially empty)
-          dup2(pipes[1], STDOUT_FILENO); // write output back to parent
-        }else{ // The last child doesnt output to the parent for the loop 
-          dup2(prev_output, STDIN_FILENO); // Read final pipe from parent
+      close(pipes[child_end]); 
+      if (pid == -1) {
+        close(pipes[1 - child_end]); 
+        fprintf(stderr, ERROR_PROCESS_SUB, strerror(errno)); 
+        return -1; 
+      }
+      sub->pid = pid; 
+      sub->fd = pipes[1 - child_end]; 
+      snprintf(sub->path, sizeof(sub->path), "/dev/fd/%d", sub->fd); 
+      entry->exec_args[sub->arg] = sub->path; 
+    }
+  }
+  return 0; 
+}
+
+/**
+ * @brief Closes the shell's end of every process substitution's pipe, once the 
+ * stages using them have their own copy. That way a substitution sees EOF, or 
+ * SIGPIPE, when the stage it is connected to is done with it. A stage run in a 
+ * shell thread uses the shell's own copy, so those are left open until it is joined. 
+ * 
+ * @param list_commands The subcommands of the line
+ * @param builtins The stages run in threads, NULL once every thread has been joined
+ */
+static void close_substitutions(struct list_head *list_commands, struct builtin_stage *builtins) {
+  struct list_head *curr; 
+  int stage = 0; 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next, stage++) {
+    struct subcommand *entry = list_entry(curr, struct subcommand, list); 
+    if (builtins != NULL && builtins[stage].started) {
+      continue; 
+    }
+    for (int i = 0; i < entry->num_subs; i++) {
+      if (entry->subs[i].fd != -1) {
+        close(entry->subs[i].fd); 
+        entry->subs[i].fd = -1; 
+      }
+    }
+  }
+}
+
+/**
+ * @brief Waits for every process substitution to finish, so what >(command) writes 
+ * is complete before the next command line runs. 
+ * 
+ * @param list_commands The subcommands of the line
+ */
+static void reap_substitutions(struct list_head *list_commands) {
+  struct list_head *curr; 
+  close_substitutions(list_commands, NULL); 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    struct subcommand *entry = list_entry(curr, struct subcommand, list); 
+    for (int i = 0; i < entry->num_subs; i++) {
+      if (entry->subs[i].pid > 0) {
+        while (waitpid(entry->subs[i].pid, NULL, 0) == -1 && errno == EINTR) {
+          continue; 
         }
+        entry->subs[i].pid = 0; 
+      }
+    }
+  }
+}
+
+/**
+ * @brief Runs the command typed on the command line including pipes. Every pipe is 
+ * made up front and every stage is started before any of them are waited on, so 
+ * all stages of a pipeline run at the same time. The parent closes its copy of each 
+ * pipe as soon as the stages on both sides have been forked, that way a reader sees 
+ * EOF when its writer exits and a writer gets SIGPIPE as soon as its reader exits. 
+ * 
+ * Commands are found on PATH before forking, a stage whose command can not be found 
+ * is never forked and exits with 127. Internal commands can be any stage, they run 
+ * in a thread of the shell, or in a forked child if they change the shell's state. 
+ * Process substitutions are started first and waited for last. 
+ * 
+ * @param subcommand_count The number of subcommands in list_commands
+ * @param list_commands The list of subcommands that are being executed 
+ * @param list_env The list of environment variables the commands run with
+ * @return int The exit code of the last stage of the pipeline
+ */
+int run_command(int subcommand_count, struct list_head *list_commands, struct list_head *list_env) {
+  struct subcommand *entry; 
+  struct list_head *curr;  
+  int (*stage_fds)[2] = malloc(subcommand_count * sizeof(*stage_fds)); // Input and output of each stage
+  char **commands = calloc(subcommand_count, sizeof(char *)); // Full path of each command
+  struct builtin_stage *builtins = calloc(subcommand_count, sizeof(struct builtin_stage)); // Stages run in threads
+  char *path = get_env_value(list_env, "PATH"); 
+  int last_status = 1; 
+  int i; 
 
-        if ( handle_input_output(entry) != -1) {
-          handleChildInExecutor(entry->exec_args[0], entry->exec_args, env); 
+  if (tracing()) {
+    trace_begin(TRACE_ENV); 
+  }
+  char **env = get_env_array(list_env); 
+  if (tracing()) {
+    trace_end(TRACE_ENV); 
+  }
+
+  for (i = 0; i < subcommand_count; i++) {
+    stage_fds[i][0] = STDIN_FILENO; 
+    stage_fds[i][1] = STDOUT_FILENO; 
+  }
+
+  if (start_substitutions(list_commands, list_env) == -1) {
+    goto cleanup; 
+  }
+
+  // Connect each stage to the next with a pipe, close on exec so children only keep 
+  // the ends they are given
+  for (i = 0; i < subcommand_count - 1; i++) {
+    int pipes[2]; 
+    if (pipe2(pipes, O_CLOEXEC) < 0) {
+      perror("Could not create pipes"); 
+      goto cleanup; 
+    }
+    stage_fds[i][1] = pipes[1]; 
+    stage_fds[i + 1][0] = pipes[0]; 
+  }
+
+  // Open every redirect before anything is started, a redirect replaces the pipe
+  i = 0; 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    entry = list_entry(curr, struct subcommand, list); 
+    entry->pid = 0; 
+    entry->status = 1; 
+    memset(&entry->usage, 0, sizeof(entry->usage)); 
+
+    int files[2] = { -1, -1 }; 
+    int error = open_redirect_files(entry, files); 
+    for (int j = 0; j < 2; j++) {
+      if (files[j] != -1) {
+        if (stage_fds[i][j] != j) {
+          close(stage_fds[i][j]); 
         }
-        exit(1); 
-      } else { // Parent process
-        prev_output=pipes[0]; //get output from the child, and ensure that we can save it for next child
-        close(pipes[1]); 
-        handleParentInExecutor(pid, 0);
+        stage_fds[i][j] = files[j]; 
       }
+    }
+    if (error == -1) {
+      goto cleanup; 
+    }
+    i++; 
+  }
 
-      i++; //increment i so that we know which command we are on
+  // Find every command on PATH in the parent, so the children exec it directly
+  i = 0; 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    entry = list_entry(curr, struct subcommand, list); 
+    if (internal_stage(entry->exec_args) != NOT_INTERNAL) {
+      i++; 
+      continue; 
     }
-  } else{  // Else, if we only have one command 
-    entry = list_entry(list_commands->next, struct subcommand, list); // Update entry to look at current subcommand
-    if (check_validity_of_files(entry) == -1) {
-      return; 
+    commands[i] = path_cache_lookup(entry->exec_args[0], path); 
+    if (commands[i] == NULL) {
+      fprintf(stderr, ERROR_CMD_NOT_FOUND, entry->exec_args[0]); 
+      entry->status = 127; 
     }
-    execute(entry->exec_args[0], entry->exec_args, entry, env); // Execute command
+    i++; 
+  }
+
+  // Start every stage, then close the parent's copy of its input and output. That 
+  // way a reader sees EOF when its writer exits and a writer gets SIGPIPE as soon 
+  // as its reader exits. Commands that were not found are never started. Internal 
+  // commands run in a thread that is handed the stage's descriptors, unless they 
+  // change the shell's state and have to be forked. 
+  if (tracing()) {
+    trace_begin(TRACE_LAUNCH); 
+  }
+  i = 0; 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    entry = list_entry(curr, struct subcommand, list); 
+    enum Internal_Stage stage = internal_stage(entry->exec_args); 
+    clock_gettime(CLOCK_MONOTONIC, &entry->usage.start); 
+    entry->usage.end = entry->usage.start; // Stages that never start took no time
+    if (stage == STAGE_THREAD) {
+      struct builtin_stage *builtin = &builtins[i]; 
+      builtin->subcmd = entry; 
+      builtin->list_env = list_env; 
+      builtin->fds[0] = stage_fds[i][0]; 
+      builtin->fds[1] = stage_fds[i][1]; 
+      if (pthread_create(&builtin->thread, NULL, builtin_thread, builtin) == 0) {
+        builtin->started = 1; 
+        stage_fds[i][0] = STDIN_FILENO; // The thread closes them now
+        stage_fds[i][1] = STDOUT_FILENO; 
+      }
+    } else if (stage == STAGE_CHILD) {
+      entry->pid = fork_builtin(entry, list_env, stage_fds[i]); 
+      if (entry->pid == -1) {
+        entry->pid = 0; 
+      }
+    } else if (commands[i] != NULL) {
+      int fds[3] = { stage_fds[i][0], stage_fds[i][1], STDERR_FILENO }; 
+      entry->pid = launch(commands[i], entry->exec_args, env, fds, entry->subs, entry->num_subs); 
+      if (entry->pid == -1) {
+        entry->pid = 0; 
+      }
+    }
+    if (tracing()) {
+      clock_gettime(CLOCK_MONOTONIC, &entry->usage.launched); 
+    }
+    close_stage_fds(stage_fds[i]); 
+    i++; 
+  }
+
+  close_substitutions(list_commands, builtins); 
+
+  // Reap every stage that was started
+  if (tracing()) {
+    trace_end(TRACE_LAUNCH); 
+    trace_begin(TRACE_WAIT); 
   }
+  reap_stages(list_commands, subcommand_count); 
+  i = 0; 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    entry = list_entry(curr, struct subcommand, list); 
+    if (builtins[i].started) {
+      pthread_join(builtins[i].thread, NULL); 
+    }
+    last_status = entry->status; 
+    i++; 
+  }
+  if (tracing()) {
+    trace_end(TRACE_WAIT); 
+  }
+
+cleanup: 
+  reap_substitutions(list_commands); 
+  for (i = 0; i < subcommand_count; i++) {
+    close_stage_fds(stage_fds[i]); 
+    free(commands[i]); 
+  }
+  free(stage_fds); 
+  free(commands); 
+  free(builtins); 
+  return last_status; 
+}
+
+/**
+ * @brief Replaces the shell with a single command, used for the last command of a 
+ * script so it is not forked. The redirects are applied to the shell's own input and 
+ * output first. Only returns if the command could not be run. 
+ * 
+ * @param list_commands The list holding the one subcommand being executed
+ * @param list_env The list of environment variables the command runs with
+ * @return int The exit code to use when the command could not be run
+ */
+int exec_command(struct list_head *list_commands, struct list_head *list_env) {
+  struct subcommand *entry = list_entry(list_commands->next, struct subcommand, list); 
+  int files[2] = { -1, -1 }; 
+
+  char *command = path_cache_lookup(entry->exec_args[0], get_env_value(list_env, "PATH")); 
+  if (command == NULL) {
+    fprintf(stderr, ERROR_CMD_NOT_FOUND, entry->exec_args[0]); 
+    return 127; 
+  }
+  if (open_redirect_files(entry, files) == -1) {
+    free(command); 
+    return 1; 
+  }
+  for (int i = 0; i < 2; i++) {
+    if (files[i] != -1) {
+      dup2(files[i], i); 
+      close(files[i]); 
+    }
+  }
+
+  fflush(NULL); 
+  exec_file(command, entry->exec_args, get_env_array(list_env)); 
+  fprintf(stderr, ERROR_EXEC_FAILED, strerror(errno)); 
+  free(command); 
+  return 126; 
+}
+
+/**
+ * @brief Starts a single command in the background with the given file descriptors 
+ * as its stdin, stdout and stderr. The caller is responsible for reaping the child. 
+ * 
+ * @param exec_args The NULL terminated array of args sent to exec 
+ * @param env The environment array passed to exec, its PATH is used to find the command
+ * @param in_fd The file descriptor the command reads from
+ * @param out_fd The file descriptor the command writes to
+ * @param err_fd The file descriptor the command writes errors to
+ * @return pid_t The process id of the child, or -1 if it could not be started
+ */
+pid_t spawn_command(char **exec_args, char **env, int in_fd, int out_fd, int err_fd) {
+  char *path = NULL; 
+  for (int i = 0; env[i] != NULL; i++) {
+    if (strncmp(env[i], "PATH=", 5) == 0) {
+      path = env[i] + 5; 
+    }
+  }
+
+  char *command = path_cache_lookup(exec_args[0], path); 
+  if (command == NULL) {
+    return -1; 
+  }
+
+  int fds[3] = { in_fd, out_fd, err_fd }; 
+  pid_t pid = launch(command, exec_args, env, fds, NULL, 0); 
+  free(command); 
+  return pid; 
 }
@@ -8,5 +8,20 @@
 #include "datastructures.h"
 #include "list.h"
 
-void run_command(int subcommand_count, struct list_head *list_commands, char **env);
-#endif
\ No newline at end of file
+/**
+ * @brief The ways child processes can be started. 
+ */
+enum Launcher {
+  LAUNCH_SPAWN, 
+  LAUNCH_FORK
+}; 
+
+void set_launcher(enum Launcher new_launcher); 
+int run_command(int subcommand_count, struct list_head *list_commands, struct list_head *list_env);
+int open_redirect_files(struct subcommand *subcmd, int fds[2]); 
+int run_forked_line(int subcommand_count, struct list_head *list_commands, struct list_head *list_env); 
+pid_t run_background(int subcommand_count, struct list_head *list_commands, struct list_head *list_env); 
+int exit_code_from_status(int status); 
+int exec_command(struct list_head *list_commands, struct list_head *list_env); 
+pid_t spawn_command(char **exec_args, char **env, int in_fd, int out_fd, int err_fd); 
+#endif
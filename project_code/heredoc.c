@@ -0,0 +1,163 @@
+/**
+ * @file heredoc.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Here-documents (<< and <<-) and here-strings (<<<). The body of a 
+ * here-document is the lines after the command line, up to a line holding only the 
+ * delimiter, read from the same script or input as the command line. The input is 
+ * handed to the command without touching the disk: a small body is written into a 
+ * pipe, anything larger into a sealed memfd the command reads like a file. 
+ * @version 0.1
+ * @date 2021-04-21
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#define _GNU_SOURCE // for memfd_create and the F_SEAL flags
+#include <errno.h> // for errno
+#include <fcntl.h> // for fcntl
+#include <limits.h> // for PIPE_BUF
+#include <stdio.h> // for open_memstream
+#include <stdlib.h> // for free
+#include <string.h> // for strcmp
+#include <sys/mman.h> // for memfd_create
+#include <sys/uio.h> // for writev
+#include <unistd.h> // for pipe2
+
+#include "heredoc.h"
+#include "arena.h"
+#include "error.h"
+
+#define HEREDOC_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) // Nothing can change the body
+
+/**
+ * @brief Reads the body of one here-document. The body stays in the arena with the 
+ * rest of the command line. 
+ * 
+ * @param subcmd The subcommand, its input is the delimiter and becomes the body
+ * @param reader Where the body's lines come from
+ * @param arena The arena the body is copied into
+ * @return int 0 on success, -1 if memory ran out
+ */
+static int read_heredoc(struct subcommand *subcmd, struct line_reader *reader, struct arena *arena) {
+  char *body = NULL; 
+  size_t size = 0; 
+  FILE *stream = open_memstream(&body, &size); 
+  if (stream == NULL) {
+    return -1; 
+  }
+
+  char *line; 
+  while ((line = line_reader_next(reader)) != NULL) {
+    if (subcmd->input_type == REDIRECT_HEREDOC_STRIP) {
+      line += strspn(line, "\t"); 
+    }
+    if (strcmp(line, subcmd->input) == 0) {
+      break; 
+    }
+    fputs(line, stream); 
+    fputc('\n', stream); 
+  }
+  if (line == NULL) { // Like other shells, what was read is still used
+    fprintf(stderr, ERROR_HEREDOC_EOF, subcmd->input); 
+  }
+
+  fclose(stream); 
+  subcmd->input = arena_strndup(arena, body, size); 
+  subcmd->input_type = REDIRECT_HEREDOC; 
+  free(body); 
+  return 0; 
+}
+
+/**
+ * @brief Reads the bodies of every here-document on a command line, in the order 
+ * they appear. The lines they are read from are consumed, so they are not run. 
+ * 
+ * @param list_commands The subcommands of the line
+ * @param reader Where the line came from
+ * @param arena The command line's arena
+ * @return int 0 on success, -1 on error
+ */
+int read_heredocs(struct list_head *list_commands, struct line_reader *reader, struct arena *arena) {
+  struct list_head *curr; 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    struct subcommand *sub = list_entry(curr, struct subcommand, list); 
+    if (sub->input_type == REDIRECT_HEREDOC || sub->input_type == REDIRECT_HEREDOC_STRIP) {
+      if (read_heredoc(sub, reader, arena) == -1) {
+        return -1; 
+      }
+    }
+  }
+  return 0; 
+}
+
+/**
+ * @brief Writes all of a here-document or here-string to a descriptor. 
+ * 
+ * @param fd Where it is written
+ * @param parts The body, then the newline a here-string ends with
+ * @return int 0 on success, -1 on error
+ */
+static int write_body(int fd, struct iovec parts[2]) {
+  int part = 0; 
+  while (part < 2) {
+    ssize_t written = writev(fd, parts + part, 2 - part); 
+    if (written == -1 && errno == EINTR) {
+      continue; 
+    } else if (written == -1) {
+      return -1; 
+    }
+    while (part < 2 && (size_t) written >= parts[part].iov_len) {
+      written -= parts[part].iov_len; 
+      part++; 
+    }
+    if (part < 2) {
+      parts[part].iov_base = (char *) parts[part].iov_base + written; 
+      parts[part].iov_len -= written; 
+    }
+  }
+  return 0; 
+}
+
+/**
+ * @brief Makes a descriptor that reads back a subcommand's here-document or 
+ * here-string. A body that fits in a pipe's guaranteed room goes into a pipe, a 
+ * larger one into a memfd that is sealed and rewound, so the command can even seek 
+ * in it. 
+ * 
+ * @param subcmd The subcommand
+ * @return int The descriptor, close on exec, or -1 on error
+ */
+int open_heredoc(struct subcommand *subcmd) {
+  struct iovec parts[2] = {
+    { subcmd->input, strlen(subcmd->input) }, 
+    { "\n", subcmd->input_type == REDIRECT_HERESTRING ? 1 : 0 } 
+  }; 
+  size_t size = parts[0].iov_len + parts[1].iov_len; 
+
+  if (size <= PIPE_BUF) { // A new pipe always has room, writing it never blocks
+    int fds[2]; 
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+      return -1; 
+    }
+    int result = write_body(fds[1], parts); 
+    close(fds[1]); 
+    if (result == -1) {
+      close(fds[0]); 
+      return -1; 
+    }
+    return fds[0]; 
+  }
+
+  int fd = memfd_create("sush-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING); 
+  if (fd == -1) {
+    return -1; 
+  }
+  if (write_body(fd, parts) == -1 || fcntl(fd, F_ADD_SEALS, HEREDOC_SEALS) == -1 || 
+      lseek(fd, 0, SEEK_SET) == -1) {
+    close(fd); 
+    return -1; 
+  }
+  return fd; 
+}
@@ -0,0 +1,11 @@
+#ifndef HEREDOC_H
+#define HEREDOC_H
+
+#include "datastructures.h"
+#include "linereader.h"
+#include "list.h"
+
+int read_heredocs(struct list_head *list_commands, struct line_reader *reader, struct arena *arena); 
+int open_heredoc(struct subcommand *subcmd); 
+
+#endif
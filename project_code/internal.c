@@ -8,18 +8,31 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <limits.h>
 
 #include "datastructures.h"
 #include "list.h"
 #include "error.h"
 #include "environ.h"
+#include "jobs.h"
+#include "pathcache.h"
+#include "utilities.h"
+#include "executor.h"
+#include "background.h"
+#include "parallel.h"
+#include "resultcache.h"
 
 #define BUFFER_SIZE 4096
 
+#define SHELL_EXIT -6 // Returned by a handler when the shell should exit
+
 // Struct for internal commands, used to create a table of commands 
 typedef struct internal {
   const char *name; 
-  int (*handler)(struct subcommand *subcommand, struct list_head *list_env); 
+  int (*handler)(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+  int isolate; // 1 if it changes the shell's state, so in a pipeline it runs in a child
+  int plain_args; // 1 if the program on PATH runs instead when an option is given
 } internal_t;  
 
 /**
@@ -52,18 +65,6 @@ static int get_num_args(struct subcommand *subcommand) {
   return count; 
 }
 
-/**
- * @brief Get the first parsed argument that was entered on the command line.
- * This argument should be the name of the internal command that is being called.
- * @author Hannah Moats
- * 
- * @param subcommand The parsed command written on the command line
- * @return char* The name of the internal command (first argument)
- */
-static char * get_internal_command(struct subcommand *subcommand) {
-  return subcommand->exec_args[0]; 
-}
-
 /**
  * @brief Get the second parsed argument that was entered on the command line. 
  * This argument should be either a path name, or a name of an environment variable. 
@@ -94,9 +95,11 @@ static char * get_third_argument(struct subcommand *subcommand) {
  * @author Hannah Moats
  * 
  * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
  * @return int If an error occured, output is -1 else output is 0
  */
-static int handle_setenv(struct subcommand *subcommand, struct list_head *list_env) {
+static int handle_setenv(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
   //checks that the setenv command is valid
   int num_args = get_num_args(subcommand); 
   if (num_args != 3) { //plus 1 since we store a NULL at the end
@@ -108,7 +111,6 @@ static int handle_setenv(struct subcommand *subcommand, struct list_head *list_e
   char *name = get_second_argument(subcommand); 
   char *value = get_third_argument(subcommand); 
   set_env(list_env, name, value); 
-  int status = setenv(name, value, 1); 
   return 0; 
 }
 
@@ -118,16 +120,17 @@ static int handle_setenv(struct subcommand *subcommand, struct list_head *list_e
  * @author Hannah Moats
  * 
  * @param subcommand A parsed command from the commandline 
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
  * @return int If an error occured, output is -1 else output is 0
  */
-static int handle_getenv(struct subcommand *subcommand, struct list_head *list_env) {
+static int handle_getenv(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
   int num_args = get_num_args(subcommand); 
   if (num_args == 1) { //subcommand: getenv
-    display_env_list(list_env); 
+    write_env_list(list_env, io->stream); 
   } else if (num_args == 2) { //subcommmand: getenv $NAME
     char *name = get_second_argument(subcommand); 
     char *env_list = get_env(list_env, name); 
-    char *env = getenv(name); 
 
     //error check
     if (env_list == NULL) {
@@ -135,7 +138,7 @@ static int handle_getenv(struct subcommand *subcommand, struct list_head *list_e
       return -1; 
     }
 
-    printf("%s\n", env_list); 
+    fprintf(io->stream, "%s\n", env_list); 
   } else { //error: there ere not enough arguments or too many 
     fprintf(stderr, ERROR_GETENV_ARG);
     return -1; 
@@ -149,18 +152,18 @@ static int handle_getenv(struct subcommand *subcommand, struct list_head *list_e
  * @author Hannah Moats
  * 
  * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
  * @return int If an error occured, output is -1 else output is 0
  */
-static int handle_unsetenv(struct subcommand *subcommand, struct list_head *list_env) {
+static int handle_unsetenv(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
   int num_args = get_num_args(subcommand); 
   if (num_args != 2) { //plus 1 since we store a NULL at the end
     fprintf(stderr, ERROR_UNSETENV_ARG); 
     return -1; 
   }
   char *name = get_second_argument(subcommand); 
-  int status = unset_env(list_env, name); 
-  status = unsetenv(name); 
-  
+  unset_env(list_env, name); 
   return 0;
 }
 
@@ -171,16 +174,17 @@ static int handle_unsetenv(struct subcommand *subcommand, struct list_head *list
  * @author Hannah Moats
  * 
  * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
  * @return int If an error occured, output is -1 else output is 0
  */
-static int handle_cd(struct subcommand *subcommand, struct list_head *list_env) {
+static int handle_cd(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
   int num_args = get_num_args(subcommand); 
   if (num_args == 1) { //subcommand: cd
-    char *home = getenv("HOME"); //get home env variable 
-    int status = chdir(home); 
+    char *home = get_env_value(list_env, "HOME"); //get home env variable 
 
     //check for error
-    if (status == -1) {
+    if (home == NULL || chdir(home) == -1) {
       fprintf(stderr, ERROR_CD_NOHOME); 
       return -1; 
     }
@@ -206,9 +210,11 @@ static int handle_cd(struct subcommand *subcommand, struct list_head *list_env)
  * @author Hannah Moats
  * 
  * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
  * @return int If an error occured, output is -1 else output is 0
  */
-static int handle_pwd(struct subcommand *subcommand, struct list_head *list_env) {
+static int handle_pwd(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
   //#define ERROR_PWD_ARG "Error - pwd takes no arguments\n"
   int num_args = get_num_args(subcommand); 
   if (num_args != 1) { //subcommand is NOT: pwd
@@ -218,7 +224,7 @@ static int handle_pwd(struct subcommand *subcommand, struct list_head *list_env)
 
   char buf[BUFFER_SIZE]; 
   char *status = getcwd(buf, sizeof(buf)); 
-  printf("%s\n", buf); 
+  fprintf(io->stream, "%s\n", buf); 
   memset(buf, 0, BUFFER_SIZE); 
 
   if (status == NULL) {
@@ -234,48 +240,404 @@ static int handle_pwd(struct subcommand *subcommand, struct list_head *list_env)
  * @author Hannah Moats
  * 
  * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
  * @return int Returns a code to be processed by sush to clear list_command and exit. 
  */
-static int handle_exit(struct subcommand *subcommand, struct list_head *list_env) {
+static int handle_exit(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
   int num_args = get_num_args(subcommand); 
   if (num_args != 1) {
     fprintf(stderr, ERROR_EXIT_ARG); 
     return -1;
   }
-  return 6; 
+  return SHELL_EXIT; 
+}
+
+/**
+ * @brief Handles the queue internal command. The queue command adds a command to
+ * the job queue, where it is run in the background once there is a free CPU. 
+ * queue --after 3,5 cmd args... only runs it once tasks 3 and 5 have succeeded. 
+ * The task number of the job is printed, for output, cancel and queue --after. 
+ * 
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
+ * @return int If an error occured, output is -1 else output is 0
+ */
+static int handle_queue(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = get_num_args(subcommand); 
+  int first = 1; 
+  int *after = NULL; 
+  int num_after = 0; 
+  if (num_args > 2 && strcmp(subcommand->exec_args[1], "--after") == 0) { //subcommand: queue --after tasks cmd args...
+    char *tasks = subcommand->exec_args[2]; 
+    char *cursor = tasks; 
+    after = malloc((strlen(tasks) / 2 + 1) * sizeof(int)); // Every task but the last ends in a comma
+    for (;;) {
+      char *end; 
+      long task = strtol(cursor, &end, 10); 
+      if (end == cursor || task < 0 || task > INT_MAX || (*end != ',' && *end != '\0')) {
+        fprintf(stderr, ERROR_QUEUE_AFTER, tasks); 
+        free(after); 
+        return -1; 
+      }
+      after[num_after++] = task; 
+      if (*end == '\0') {
+        break; 
+      }
+      cursor = end + 1; 
+    }
+    first = 3; 
+  }
+  if (num_args < first + 1) { //subcommand is NOT: queue cmd args...
+    fprintf(stderr, ERROR_QUEUE_ARG); 
+    free(after); 
+    return -1; 
+  }
+
+  //the job gets its own copy of the environment as it is right now 
+  int result = jobs_queue(&subcommand->exec_args[first], make_env_array(list_env), after, num_after); 
+  free(after); 
+  if (result == -1) {
+    return -1; 
+  }
+  fprintf(io->stream, MSG_QUEUED, result); 
+  return 0; 
+}
+
+/**
+ * @brief Handles the status internal command. The status command prints whether 
+ * each queued job is queued, running or complete. 
+ * 
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
+ * @return int If an error occured, output is -1 else output is 0
+ */
+static int handle_status(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = get_num_args(subcommand); 
+  if (num_args != 1) { //subcommand is NOT: status
+    fprintf(stderr, ERROR_STATUS_ARG); 
+    return -1; 
+  }
+  jobs_status(io->stream); 
+  return 0; 
+}
+
+/**
+ * @brief Handles the output internal command. The output command prints the output
+ * of a job once it is complete. 
+ * 
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
+ * @return int If an error occured, output is -1 else output is 0
+ */
+static int handle_output(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = get_num_args(subcommand); 
+  if (num_args != 2) { //subcommand is NOT: output N
+    fprintf(stderr, ERROR_OUTPUT_ARG); 
+    return -1; 
+  }
+  return jobs_output(get_second_argument(subcommand), io->stream); 
+}
+
+/**
+ * @brief Handles the cancel internal command. The cancel command stops a job from 
+ * being started, or kills it if it is already running. 
+ * 
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
+ * @return int If an error occured, output is -1 else output is 0
+ */
+static int handle_cancel(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = get_num_args(subcommand); 
+  if (num_args != 2) { //subcommand is NOT: cancel N
+    fprintf(stderr, ERROR_CANCEL_ARG); 
+    return -1; 
+  }
+  return jobs_cancel(get_second_argument(subcommand), io->stream); 
+}
+
+/**
+ * @brief Handles the hash internal command. With no arguments the hash command prints 
+ * every command that has been found on PATH and where it was found. hash -r forgets 
+ * them all, and hash with command names searches for those commands again. 
+ * 
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
+ * @return int If an error occured, output is -1 else output is 0
+ */
+static int handle_hash(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = get_num_args(subcommand); 
+  if (num_args == 1) { //subcommand: hash
+    path_cache_display(get_env_value(list_env, "PATH"), io->stream); 
+    return 0; 
+  } else if (num_args == 2 && strcmp(get_second_argument(subcommand), "-r") == 0) { //subcommand: hash -r
+    path_cache_clear(); 
+    return 0; 
+  }
+
+  //subcommand: hash name...
+  int status = 0; 
+  for (int i = 1; i < num_args; i++) {
+    if (path_cache_add(subcommand->exec_args[i], get_env_value(list_env, "PATH")) == -1) {
+      fprintf(stderr, ERROR_HASH_NOT_FOUND, subcommand->exec_args[i]); 
+      status = -1; 
+    }
+  }
+  return status; 
+}
+
+/**
+ * @brief Handles the worker internal command. worker add SOCKET lets queued jobs run 
+ * on the shell started with sush --worker SOCKET, worker lists the workers added. 
+ * 
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
+ * @return int If an error occured, output is -1 else output is 0
+ */
+static int handle_worker(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = get_num_args(subcommand); 
+  if (num_args == 1) { //subcommand: worker
+    jobs_workers(io->stream); 
+    return 0; 
+  } else if (num_args != 3 || strcmp(subcommand->exec_args[1], "add") != 0) { //subcommand is NOT: worker add SOCKET
+    fprintf(stderr, ERROR_WORKER_ARG); 
+    return -1; 
+  }
+  return jobs_add_worker(subcommand->exec_args[2]) == -1 ? -1 : 0; 
+}
+
+/**
+ * @brief Handles the wait internal command. wait blocks until every command line 
+ * run in the background with & has finished, wait id... until the given ones have. 
+ * In a pipeline it runs in a thread, only the shell itself can reap the jobs. 
+ * 
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
+ * @return int The exit code of the last job waited for, 0 for every job, 127 if a job is unknown
+ */
+static int handle_wait(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = get_num_args(subcommand); 
+  if (num_args == 1) { //subcommand: wait
+    background_wait_all(); 
+    return 0; 
+  }
+
+  //subcommand: wait id...
+  int status = 0; 
+  for (int i = 1; i < num_args; i++) {
+    if (background_wait(subcommand->exec_args[i], &status) == -1) {
+      fprintf(stderr, ERROR_WAIT_INVALID, subcommand->exec_args[i]); 
+      status = 127; 
+    }
+  }
+  return status; 
 }
 
 // Declaring a table of internal commands that will be crossreferenced to when processing a command 
 internal_t internal_cmds[] = {
-  { .name = "setenv" , .handler = handle_setenv }, 
+  { .name = "setenv" , .handler = handle_setenv, .isolate = 1 }, 
   { .name = "getenv" , .handler = handle_getenv },
-  { .name = "unsetenv" , .handler = handle_unsetenv },
-  { .name = "cd", .handler = handle_cd }, 
+  { .name = "unsetenv" , .handler = handle_unsetenv, .isolate = 1 },
+  { .name = "cd", .handler = handle_cd, .isolate = 1 }, 
   { .name = "pwd", .handler = handle_pwd }, 
-  { .name = "exit", .handler = handle_exit}, 
+  { .name = "exit", .handler = handle_exit, .isolate = 1 }, 
+  { .name = "queue", .handler = handle_queue }, 
+  { .name = "status", .handler = handle_status }, 
+  { .name = "output", .handler = handle_output }, 
+  { .name = "cancel", .handler = handle_cancel }, 
+  { .name = "hash", .handler = handle_hash }, 
+  { .name = "wait", .handler = handle_wait }, // A forked child has no background jobs to wait for
+  { .name = "worker", .handler = handle_worker }, 
+  { .name = "echo", .handler = handle_echo}, 
+  { .name = "printf", .handler = handle_printf}, 
+  { .name = "true", .handler = handle_true}, 
+  { .name = "false", .handler = handle_false}, 
+  { .name = "test", .handler = handle_test}, 
+  { .name = "[", .handler = handle_test}, 
+  { .name = "copy", .handler = handle_copy}, 
+  { .name = "cat", .handler = handle_copy, .plain_args = 1 }, 
+  { .name = "parallel", .handler = handle_parallel }, 
+  { .name = "cache", .handler = handle_cache }, 
   0
 };
 
+/**
+ * @brief Finds an internal command in the table by name. 
+ * 
+ * @param name The name of the command
+ * @return internal_t* The command, or NULL if it is not an internal command
+ */
+static internal_t *lookup_internal(char *name) {
+  for (int i = 0; internal_cmds[i].name != 0; i++) {
+    if (strcmp(internal_cmds[i].name, name) == 0) {
+      return &internal_cmds[i]; 
+    }
+  }
+  return NULL; 
+}
+
+/**
+ * @brief Finds the internal command that runs a command's arguments. A builtin 
+ * that only takes plain arguments is passed over when one of them is an option, 
+ * as in cat -n, and the program on PATH runs instead. 
+ * 
+ * @param args The command's arguments, ending in NULL
+ * @return internal_t* The command, or NULL if it is not run internally
+ */
+static internal_t *find_internal(char **args) {
+  internal_t *internal = lookup_internal(args[0]); 
+  if (internal != NULL && internal->plain_args) {
+    for (int i = 1; args[i] != NULL; i++) {
+      if (args[i][0] == '-' && args[i][1] != '\0') {
+        return NULL; 
+      }
+    }
+  }
+  return internal; 
+}
+
+/**
+ * @brief Checks to see if the given name is the name of an internal command 
+ * 
+ * @param name The name of the command
+ * @return int Returns 1 if the command is an internal command, else 0 
+ */
+int is_internal_command(char *name) {
+  return lookup_internal(name) != NULL; 
+}
+
+/**
+ * @brief Tells how an internal command is run when it is one stage of a pipeline. 
+ * 
+ * @param args The command's arguments, ending in NULL
+ * @return enum Internal_Stage NOT_INTERNAL, STAGE_THREAD or STAGE_CHILD
+ */
+enum Internal_Stage internal_stage(char **args) {
+  internal_t *internal = find_internal(args); 
+  if (internal == NULL) {
+    return NOT_INTERNAL; 
+  }
+  return internal->isolate ? STAGE_CHILD : STAGE_THREAD; 
+}
+
+/**
+ * @brief Writes everything an internal command printed to its output, with as few 
+ * writes as the descriptor takes. 
+ * 
+ * @param fd Where the output goes
+ * @param buf The output
+ * @param size Bytes of output
+ */
+static void write_output(int fd, const char *buf, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, buf, size); 
+    if (written == -1 && errno == EINTR) {
+      continue; 
+    } else if (written <= 0) { // The reader is gone, the rest is dropped
+      return; 
+    }
+    buf += written; 
+    size -= written; 
+  }
+}
+
+/**
+ * @brief Runs an internal command with its output collected in memory, then 
+ * written to out all at once, so a command printing thousands of lines costs one 
+ * write instead of one per line. 
+ * 
+ * @param internal The internal command
+ * @param subcommand The parsed command
+ * @param list_env list_head List of environment variables
+ * @param in File descriptor the command reads from
+ * @param out File descriptor the output is written to
+ * @return int What the handler returned
+ */
+static int call_buffered(internal_t *internal, struct subcommand *subcommand, struct list_head *list_env, int in, int out) {
+  char *buf = NULL; 
+  size_t size = 0; 
+  struct internal_io io = { in, out, open_memstream(&buf, &size) }; 
+  if (io.stream == NULL) {
+    return -1; 
+  }
+
+  int result = internal->handler(subcommand, list_env, &io); 
+  fclose(io.stream); 
+  write_output(out, buf, size); 
+  free(buf); 
+  return result; 
+}
+
+/**
+ * @brief Runs an internal command as one stage of a pipeline. exit does nothing 
+ * here, it only ends the pipeline's stage. 
+ * 
+ * @param subcommand The internal command
+ * @param list_env list_head List of environment variables
+ * @param in File descriptor the command reads from
+ * @param out File descriptor the command writes to
+ * @return int The exit code of the command
+ */
+int run_internal(struct subcommand *subcommand, struct list_head *list_env, int in, int out) {
+  internal_t *internal = find_internal(subcommand->exec_args); 
+  int result = call_buffered(internal, subcommand, list_env, in, out); 
+  if (result == SHELL_EXIT) {
+    return 0; 
+  }
+  return result == -1 ? 1 : result; 
+}
+
 /**
  * @brief Given the command on the command line, this function determines
- * what command needs to be handled and calls the respective function.
+ * what command needs to be handled and calls the respective function. Only a 
+ * command line that is a single internal command is run here, pipelines are left 
+ * to the executor. Redirects are opened around the call, output going to a file is 
+ * collected and written at once, output to the shell's stdout uses its stdio buffer. 
  * @author Hannah Moats
  * 
- * @param subcommand A parsed command from the commandline
+ * @param commands The list of subcommands on the command line
  * @param list_env list_head List of environment variables
- * @return int If an error occured, output is -1 else output is 0
+ * @param status Set to the exit code of the internal command if one was run
+ * @return int Returns 1 if it is not an internal command, 6 if the shell should exit, else 0
  */
-int handle_internal(struct list_head *commands, struct list_head *list_env) {
-  int i = 0; 
+int handle_internal(struct list_head *commands, struct list_head *list_env, int *status) {
   struct subcommand *entry;
   entry = list_entry(commands->next, struct subcommand, list); 
 
-  while(internal_cmds[i].name != 0) {
-    char *command_name = get_internal_command(entry); 
-    if (!strcmp(internal_cmds[i].name, command_name)) {
-      return internal_cmds[i].handler(entry, list_env); 
+  internal_t *internal = find_internal(entry->exec_args); 
+  if (internal == NULL || commands->next->next != commands || entry->num_subs > 0) {
+    return 1; // Left to the executor, which connects the stages
+  }
+
+  int files[2] = { -1, -1 }; 
+  int result; 
+  if (open_redirect_files(entry, files) == -1) {
+    result = -1; 
+  } else if (files[0] == -1 && files[1] == -1) {
+    struct internal_io io = { STDIN_FILENO, STDOUT_FILENO, stdout }; 
+    result = internal->handler(entry, list_env, &io); 
+  } else {
+    fflush(stdout); // Anything printed before goes first
+    result = call_buffered(internal, entry, list_env, files[0] != -1 ? files[0] : STDIN_FILENO, 
+                           files[1] != -1 ? files[1] : STDOUT_FILENO); 
+  }
+  for (int i = 0; i < 2; i++) {
+    if (files[i] != -1) {
+      close(files[i]); 
     }
-    i++;
-  } 
-  return 1; 
+  }
+
+  if (result == SHELL_EXIT) {
+    return 6; 
+  }
+  *status = result == -1 ? 1 : result; 
+  entry->status = *status; 
+  return 0; 
 }
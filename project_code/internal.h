@@ -1,8 +1,35 @@
 #ifndef INTERNAL_H
 #define INTERNAL_H
 
+#include <stdio.h>
+
 #include "datastructures.h"
 
-int handle_internal(struct list_head *commands, struct list_head *list_env); 
+/**
+ * @brief Where an internal command reads from and writes to. 
+ * 
+ * @param in File descriptor the command reads from
+ * @param out File descriptor the command's output goes to
+ * @param stream Buffered stream writing to out, what the command prints with
+ */
+struct internal_io {
+  int in; 
+  int out; 
+  FILE *stream; 
+}; 
+
+/**
+ * @brief How an internal command is run as one stage of a pipeline. 
+ */
+enum Internal_Stage {
+  NOT_INTERNAL, 
+  STAGE_THREAD, // Run in a thread of the shell
+  STAGE_CHILD // Changes the shell's state, so it runs in a forked child like other shells do
+}; 
+
+int handle_internal(struct list_head *commands, struct list_head *list_env, int *status); 
+int is_internal_command(char *name); 
+enum Internal_Stage internal_stage(char **args); 
+int run_internal(struct subcommand *subcommand, struct list_head *list_env, int in, int out); 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,869 @@
+/**
+ * @file jobs.c
+ * @author Hannah Moats
+ * @author John Gable
+ * @author Isabella Boone
+ * @brief Handles the background job queue. Jobs are added with the queue internal
+ * command and started by a dispatcher thread, which keeps up to one job per online
+ * CPU running at a time and writes the output of every job to its own file.
+ * A job can be queued after other tasks, it is only started once all of them have
+ * completed successfully and is canceled if any of them fails or is canceled.
+ * Jobs can also run on workers added with worker add, other shells started with
+ * sush --worker. Each job goes to whichever of this shell and the workers has the
+ * smallest share of its slots in use, and its output is streamed back to its file.
+ * A forked copy of the shell has a copy of the queue but no dispatcher, so it can
+ * not queue, cancel or add workers.
+ * @version 0.1
+ * @date 2021-04-05
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/pidfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "jobs.h"
+#include "executor.h"
+#include "worker.h"
+#include "error.h"
+
+#define POLL_FALLBACK_MS 100 // How often to check jobs that have no pidfd
+
+static LIST_HEAD(job_queue); // Every job ever queued, in the order it was queued
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER; // Guards everything below
+static pthread_cond_t job_finished = PTHREAD_COND_INITIALIZER; // Signaled when a job stops
+static int dispatcher_started = 0;
+static int wake_pipe[2] = { -1, -1 }; // Written to when the dispatcher has new work
+static int max_running = 0; // Most jobs allowed to run at once
+static int num_running = 0;
+static int num_local = 0; // Running jobs that run in this shell rather than on a worker
+static int num_queued = 0;
+static int next_position = 0;
+static char *output_dir = NULL; // Directory holding the output file of each job
+static __thread int in_dispatcher = 0; // 1 in the dispatcher thread, which forks with job_lock held
+static int forked_copy = 0; // 1 in a forked copy of the shell
+
+/**
+ * @brief A shell started with sush --worker that queued jobs can be sent to.
+ *
+ * @param path The worker's socket
+ * @param slots How many jobs it runs at once
+ * @param running How many jobs it is running for this shell
+ */
+struct job_worker {
+  char *path;
+  int slots;
+  int running;
+};
+
+static struct job_worker **workers = NULL; // Every worker added, never moved or removed since running jobs point to them
+static int num_workers = 0;
+
+/**
+ * @brief Frees a NULL terminated array of strings.
+ *
+ * @param array The array being freed
+ */
+static void free_string_array(char **array) {
+  if (array == NULL) {
+    return;
+  }
+  for (int i = 0; array[i] != NULL; i++) {
+    free(array[i]);
+  }
+  free(array);
+}
+
+/**
+ * @brief Makes a copy of a NULL terminated array of strings.
+ *
+ * @param array The array being copied
+ * @return char** The new array
+ */
+static char **copy_string_array(char **array) {
+  int len = 0;
+  while (array[len] != NULL) {
+    len++;
+  }
+  char **copy = calloc(len + 1, sizeof(char *));
+  for (int i = 0; i < len; i++) {
+    copy[i] = strdup(array[i]);
+  }
+  return copy;
+}
+
+/**
+ * @brief Wakes the dispatcher thread so it looks at the queue again.
+ */
+static void wake_dispatcher(void) {
+  char c = 0;
+  ssize_t written = write(wake_pipe[1], &c, 1); // Pipe is nonblocking, a full pipe already wakes it
+  (void)written;
+}
+
+/**
+ * @brief Finds the value of a variable in an environment array.
+ *
+ * @param env The environment array
+ * @param name The name of the variable
+ * @return char* The value of the variable, or NULL if it is not set
+ */
+static char *find_in_env(char **env, const char *name) {
+  int len = strlen(name);
+  for (int i = 0; env[i] != NULL; i++) {
+    if (strncmp(env[i], name, len) == 0 && env[i][len] == '=') {
+      return env[i] + len + 1;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Gets the number of jobs that may run at once. SUSH_MAX_JOBS overrides the
+ * default of one job per online CPU.
+ *
+ * @param env The environment the first job was queued with
+ * @return int The number of jobs that may run at once
+ */
+static int get_max_running(char **env) {
+  char *max = find_in_env(env, "SUSH_MAX_JOBS");
+  if (max != NULL && atoi(max) > 0) {
+    return atoi(max);
+  }
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return cpus > 0 ? (int)cpus : 1;
+}
+
+/**
+ * @brief Finds a job by its task number. Must be called with job_lock held.
+ *
+ * @param position The task number
+ * @return struct job_command* The job, or NULL if there is no such task
+ */
+static struct job_command *find_position(long position) {
+  struct list_head *curr;
+  for (curr = job_queue.next; curr != &job_queue; curr = curr->next) {
+    struct job_command *job = list_entry(curr, struct job_command, queue);
+    if (job->position == position) {
+      return job;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Finds a job given the task number typed on the command line.
+ * Must be called with job_lock held.
+ *
+ * @param task The task number as a string
+ * @return struct job_command* The job, or NULL if there is no such task
+ */
+static struct job_command *find_job(char *task) {
+  char *end;
+  long position = strtol(task, &end, 10);
+  if (*task == '\0' || *end != '\0') {
+    return NULL;
+  }
+  return find_position(position);
+}
+
+/**
+ * @brief Checks whether every task a queued job waits for has completed successfully.
+ * Tasks can only wait for tasks queued before them, so there are never cycles.
+ * Must be called with job_lock held.
+ *
+ * @param job The queued job
+ * @param failed Set to the task that failed or was canceled, if there is one
+ * @return int 1 if the job can start, 0 if it has to wait, -1 if it never can
+ */
+static int dependencies_met(struct job_command *job, int *failed) {
+  int ready = 1;
+  for (int i = 0; i < job->num_after; i++) {
+    struct job_command *dependency = find_position(job->after[i]);
+    if (dependency->status == CANCELED || (dependency->status == COMPLETE && dependency->exit_status != 0)) {
+      *failed = dependency->position;
+      return -1;
+    } else if (dependency->status != COMPLETE) {
+      ready = 0;
+    }
+  }
+  return ready;
+}
+
+/**
+ * @brief Cancels a queued job that was never started. Must be called with job_lock held.
+ *
+ * @param job The queued job
+ */
+static void cancel_queued(struct job_command *job) {
+  job->status = CANCELED;
+  num_queued--;
+  free_string_array(job->env);
+  job->env = NULL;
+  pthread_cond_broadcast(&job_finished);
+}
+
+/**
+ * @brief Marks a job as complete and releases what it no longer needs.
+ * Must be called with job_lock held.
+ *
+ * @param job The job that has stopped
+ * @param exit_status The exit code of the job
+ */
+static void finish_job(struct job_command *job, int exit_status) {
+  if (job->pidfd != -1) {
+    close(job->pidfd);
+    job->pidfd = -1;
+  }
+  if (job->worker != NULL) {
+    if (job->socket != -1) {
+      close(job->socket);
+      job->socket = -1;
+    }
+    if (job->output_fd != -1) {
+      close(job->output_fd);
+      job->output_fd = -1;
+    }
+    if (job->reader != NULL) {
+      worker_reader_free(job->reader);
+      free(job->reader);
+      job->reader = NULL;
+    }
+    job->worker->running--;
+  } else {
+    num_local--;
+  }
+  job->exit_status = exit_status;
+  job->status = COMPLETE;
+  free_string_array(job->env);
+  job->env = NULL;
+  num_running--;
+  pthread_cond_broadcast(&job_finished);
+}
+
+/**
+ * @brief Starts a queued job with its output going to its own file.
+ * Must be called with job_lock held.
+ *
+ * @param job The job being started
+ */
+static void start_job(struct job_command *job) {
+  num_queued--;
+  num_running++;
+  num_local++;
+  job->status = RUNNING;
+
+  int out_fd = open(job->output_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  int in_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (out_fd == -1 || in_fd == -1) {
+    fprintf(stderr, ERROR_QUEUE_START, job->position, strerror(errno));
+  } else {
+    job->process_id = spawn_command(job->exec_args, job->env, in_fd, out_fd, out_fd);
+    if (job->process_id == -1) {
+      fprintf(stderr, ERROR_QUEUE_START, job->position, strerror(errno));
+    }
+  }
+  if (out_fd != -1) {
+    close(out_fd);
+  }
+  if (in_fd != -1) {
+    close(in_fd);
+  }
+
+  if (job->process_id <= 0) {
+    finish_job(job, 1);
+    return;
+  }
+  job->pidfd = pidfd_open(job->process_id, 0); // -1 on old kernels, then it is polled
+}
+
+/**
+ * @brief Sends a queued job to a worker, its output is written to its file as it
+ * comes back. Must be called with job_lock held.
+ *
+ * @param job The job being started
+ * @param worker The worker it runs on
+ */
+static void start_remote_job(struct job_command *job, struct job_worker *worker) {
+  char cwd[4096];
+  num_queued--;
+  num_running++;
+  worker->running++;
+  job->status = RUNNING;
+  job->worker = worker;
+
+  job->output_fd = open(job->output_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (job->output_fd != -1 && getcwd(cwd, sizeof(cwd)) != NULL) {
+    job->socket = worker_start_job(worker->path, job->exec_args, job->env, cwd);
+  }
+  if (job->socket == -1) {
+    fprintf(stderr, ERROR_QUEUE_START, job->position, strerror(errno));
+    finish_job(job, 1);
+    return;
+  }
+  fcntl(job->socket, F_SETFL, fcntl(job->socket, F_GETFL) | O_NONBLOCK); // Read with job_lock held
+  job->reader = calloc(1, sizeof(struct frame_reader));
+}
+
+/**
+ * @brief Acts on one frame a worker sent back for a job. Must be called with job_lock held.
+ *
+ * @param job The job running on a worker
+ * @param type What the frame holds
+ * @param data The frame's bytes
+ * @param length The number of bytes
+ */
+static void handle_remote_frame(struct job_command *job, enum Worker_Frame type, char *data, uint32_t length) {
+  if (type == FRAME_OUTPUT) {
+    for (uint32_t done = 0; done < length; ) {
+      ssize_t written = write(job->output_fd, data + done, length - done);
+      if (written == -1 && errno == EINTR) {
+        continue;
+      } else if (written == -1) {
+        break;
+      }
+      done += written;
+    }
+  } else if (type == FRAME_STATUS && length == sizeof(int32_t)) {
+    int32_t status;
+    memcpy(&status, data, sizeof(status));
+    finish_job(job, status);
+  }
+}
+
+/**
+ * @brief Reads what a worker sent back for a job, finishing the job once its exit code
+ * comes. Only what has already arrived is read, a frame cut short is finished next
+ * time. Must be called with job_lock held.
+ *
+ * @param job The job running on a worker
+ */
+static void read_remote_job(struct job_command *job) {
+  enum Worker_Frame type;
+  char *data;
+  uint32_t length;
+  int result;
+  while (job->status == RUNNING && (result = worker_read_some(job->socket, job->reader, &type, &data, &length)) != 0) {
+    if (result == -1) { // The worker went away
+      finish_job(job, 1);
+      return;
+    }
+    handle_remote_frame(job, type, data, length);
+    free(data);
+  }
+}
+
+/**
+ * @brief Picks where the next job runs: this shell or the worker with the smallest share
+ * of its slots in use. Must be called with job_lock held.
+ *
+ * @param worker Set to the worker, or NULL for this shell
+ * @return int 1 if somewhere has a free slot, else 0
+ */
+static int least_loaded(struct job_worker **worker) {
+  int running = num_local;
+  int slots = max_running;
+  int found = num_local < max_running;
+  *worker = NULL;
+  for (int i = 0; i < num_workers; i++) {
+    struct job_worker *candidate = workers[i];
+    if (candidate->running < candidate->slots &&
+        (!found || candidate->running * slots < running * candidate->slots)) {
+      *worker = candidate;
+      running = candidate->running;
+      slots = candidate->slots;
+      found = 1;
+    }
+  }
+  return found;
+}
+
+/**
+ * @brief Reaps a running job if it has exited. Must be called with job_lock held.
+ *
+ * @param job The running job being checked
+ */
+static void reap_job(struct job_command *job) {
+  int status;
+  if (waitpid(job->process_id, &status, WNOHANG) > 0) {
+    if (WIFEXITED(status)) {
+      finish_job(job, WEXITSTATUS(status));
+    } else {
+      finish_job(job, 128 + WTERMSIG(status));
+    }
+  }
+}
+
+/**
+ * @brief The dispatcher thread. Starts queued jobs in order while there is room,
+ * then sleeps until a running job exits or more work is queued.
+ *
+ * @param arg Unused
+ * @return void* Never returns
+ */
+static void *dispatcher_main(void *arg) {
+  struct pollfd *fds = NULL;
+  struct job_command **polled = NULL;
+  int capacity = 0;
+  in_dispatcher = 1;
+
+  while (1) {
+    pthread_mutex_lock(&job_lock);
+
+    // Start as many ready jobs as there is room for, oldest first. A job is only
+    // ever after older ones, so one pass also cancels everything after a failure.
+    struct list_head *curr;
+    for (curr = job_queue.next; curr != &job_queue; curr = curr->next) {
+      struct job_command *job = list_entry(curr, struct job_command, queue);
+      int failed;
+      if (job->status != QUEUED) {
+        continue;
+      }
+      int ready = dependencies_met(job, &failed);
+      struct job_worker *worker;
+      if (ready == -1) {
+        fprintf(stderr, MSG_QUEUE_DEPENDENCY, job->position, failed);
+        cancel_queued(job);
+      } else if (ready == 1 && least_loaded(&worker)) {
+        if (worker != NULL) {
+          start_remote_job(job, worker);
+        } else {
+          start_job(job);
+        }
+      }
+    }
+
+    // Watch the wake pipe, and the pidfd or worker connection of every running job
+    if (capacity < num_running + 1) {
+      capacity = (num_running + 1) * 2;
+      fds = realloc(fds, capacity * sizeof(struct pollfd));
+      polled = realloc(polled, capacity * sizeof(struct job_command *));
+    }
+    int num_fds = 1;
+    int timeout = -1;
+    fds[0].fd = wake_pipe[0];
+    fds[0].events = POLLIN;
+    for (curr = job_queue.next; curr != &job_queue; curr = curr->next) {
+      struct job_command *job = list_entry(curr, struct job_command, queue);
+      if (job->status != RUNNING) {
+        continue;
+      }
+      if (job->worker == NULL && job->pidfd == -1) {
+        timeout = POLL_FALLBACK_MS;
+      }
+      fds[num_fds].fd = job->worker != NULL ? job->socket : job->pidfd; // A negative fd is skipped by poll
+      fds[num_fds].events = POLLIN;
+      fds[num_fds].revents = 0;
+      polled[num_fds] = job;
+      num_fds++;
+    }
+    pthread_mutex_unlock(&job_lock);
+
+    if (poll(fds, num_fds, timeout) == -1 && errno != EINTR) {
+      perror("poll");
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char drain[64];
+      while (read(wake_pipe[0], drain, sizeof(drain)) > 0);
+    }
+
+    pthread_mutex_lock(&job_lock);
+    for (int i = 1; i < num_fds; i++) {
+      struct job_command *job = polled[i];
+      if (job->status == RUNNING && job->worker != NULL && fds[i].revents) {
+        read_remote_job(job);
+      } else if (job->status == RUNNING && job->worker == NULL && (fds[i].revents || job->pidfd == -1)) {
+        reap_job(job);
+      }
+    }
+    pthread_mutex_unlock(&job_lock);
+  }
+  return arg;
+}
+
+/**
+ * @brief Starts the dispatcher thread and makes the output directory the first time
+ * a job is queued. Must be called with job_lock held.
+ *
+ * @param env The environment the first job was queued with
+ * @return int Returns -1 if the queue could not be started, else 0
+ */
+static int start_dispatcher(char **env) {
+  if (dispatcher_started) {
+    return 0;
+  }
+
+  const char *tmpdir = find_in_env(env, "TMPDIR");
+  if (tmpdir == NULL || *tmpdir == '\0') {
+    tmpdir = "/tmp";
+  }
+  if (asprintf(&output_dir, "%s/sush-jobs-XXXXXX", tmpdir) == -1 || mkdtemp(output_dir) == NULL) {
+    perror("Could not make job output directory");
+    return -1;
+  }
+  if (pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+    perror("Could not create pipes");
+    return -1;
+  }
+
+  // The dispatcher never handles signals, they are left to the main thread
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  pthread_t dispatcher;
+  int error = pthread_create(&dispatcher, NULL, dispatcher_main, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (error != 0) {
+    fprintf(stderr, "Could not start job dispatcher : %s\n", strerror(error));
+    return -1;
+  }
+  pthread_detach(dispatcher);
+
+  max_running = get_max_running(env);
+  dispatcher_started = 1;
+  return 0;
+}
+
+/**
+ * @brief Takes job_lock before a fork, so the child never gets it locked by a thread
+ * it does not have. The dispatcher already holds it when it forks.
+ */
+static void lock_before_fork(void) {
+  if (!in_dispatcher) {
+    pthread_mutex_lock(&job_lock);
+  }
+}
+
+/**
+ * @brief Gives back job_lock in the shell after a fork.
+ */
+static void unlock_in_parent(void) {
+  if (!in_dispatcher) {
+    pthread_mutex_unlock(&job_lock);
+  }
+}
+
+/**
+ * @brief Gives back job_lock in a forked copy of the shell and marks it as a copy.
+ */
+static void unlock_in_child(void) {
+  forked_copy = 1;
+  if (!in_dispatcher) {
+    pthread_mutex_unlock(&job_lock);
+  }
+}
+
+/**
+ * @brief Sets up the job queue, must be called once before any thread is started.
+ */
+void jobs_init(void) {
+  pthread_atfork(lock_before_fork, unlock_in_parent, unlock_in_child);
+}
+
+/**
+ * @brief Checks that the job queue can be changed, which only the shell itself can do.
+ *
+ * @param command The internal command changing it
+ * @return int 0 if it can be, else -1
+ */
+static int check_not_forked(const char *command) {
+  if (forked_copy) {
+    fprintf(stderr, ERROR_JOBS_FORKED, command);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Adds a command to the end of the job queue.
+ *
+ * @param exec_args The NULL terminated command being queued, it is copied
+ * @param env The environment the job runs with, the queue takes ownership of it
+ * @param after The task numbers the job waits for, copied
+ * @param num_after The number of tasks in after
+ * @return int The task number of the job, or -1 if it could not be queued
+ */
+int jobs_queue(char **exec_args, char **env, int *after, int num_after) {
+  if (check_not_forked("queue") == -1) {
+    free_string_array(env);
+    return -1;
+  }
+  pthread_mutex_lock(&job_lock);
+  for (int i = 0; i < num_after; i++) {
+    if (find_position(after[i]) == NULL) {
+      pthread_mutex_unlock(&job_lock);
+      fprintf(stderr, ERROR_TASK_INVALID_NUM, after[i]);
+      free_string_array(env);
+      return -1;
+    }
+  }
+  if (start_dispatcher(env) == -1) {
+    pthread_mutex_unlock(&job_lock);
+    free_string_array(env);
+    return -1;
+  }
+
+  struct job_command *job = calloc(1, sizeof(struct job_command));
+  job->exec_args = copy_string_array(exec_args);
+  job->env = env;
+  job->position = next_position++;
+  job->status = QUEUED;
+  job->pidfd = -1;
+  job->socket = -1;
+  job->output_fd = -1;
+  if (num_after > 0) {
+    job->after = malloc(num_after * sizeof(int));
+    memcpy(job->after, after, num_after * sizeof(int));
+    job->num_after = num_after;
+  }
+  if (asprintf(&job->output_file, "%s/%d.out", output_dir, job->position) == -1) {
+    job->output_file = NULL;
+  }
+  list_add_tail(&job->queue, &job_queue);
+  num_queued++;
+  pthread_mutex_unlock(&job_lock);
+
+  wake_dispatcher();
+  return job->position;
+}
+
+/**
+ * @brief Writes what was printed into a memstream while job_lock was held.
+ *
+ * @param out The memstream, or stream if one could not be made
+ * @param stream Where the text goes
+ * @param text The memstream's buffer, set when it is closed
+ * @param size The memstream's size, set when it is closed
+ */
+static void flush_status(FILE *out, FILE *stream, char **text, size_t *size) {
+  if (out != stream) {
+    fclose(out);
+    fwrite(*text, 1, *size, stream);
+  }
+  free(*text);
+}
+
+/**
+ * @brief Prints the status of every job that has been queued.
+ *
+ * @param stream Where the status is printed
+ */
+void jobs_status(FILE *stream) {
+  struct list_head *curr;
+  char *text = NULL;
+  size_t size = 0;
+  FILE *out = open_memstream(&text, &size); // Written once job_lock is let go, a full pipe must not hold it
+  if (out == NULL) {
+    out = stream;
+  }
+
+  pthread_mutex_lock(&job_lock);
+  for (curr = job_queue.next; curr != &job_queue; curr = curr->next) {
+    struct job_command *job = list_entry(curr, struct job_command, queue);
+    int failed;
+    if (job->status == QUEUED && dependencies_met(job, &failed) == 0) {
+      for (int i = 0; i < job->num_after; i++) {
+        if (find_position(job->after[i])->status != COMPLETE) {
+          fprintf(out, MSG_STATUS_WAITING, job->position, job->after[i]);
+          break;
+        }
+      }
+    } else if (job->status == QUEUED) {
+      fprintf(out, MSG_STATUS_QUEUED, job->position);
+    } else if (job->status == RUNNING && job->worker != NULL) {
+      fprintf(out, MSG_STATUS_REMOTE, job->position, job->worker->path);
+    } else if (job->status == RUNNING) {
+      fprintf(out, MSG_STATUS_RUNNING, job->position, job->process_id);
+    } else if (job->status == COMPLETE) {
+      fprintf(out, MSG_STATUS_COMPLETE, job->position);
+    } else {
+      fprintf(out, MSG_STATUS_CANCELED, job->position);
+    }
+  }
+  pthread_mutex_unlock(&job_lock);
+  flush_status(out, stream, &text, &size);
+}
+
+/**
+ * @brief Prints the output of a job that has completed.
+ *
+ * @param task The task number typed on the command line
+ * @param stream Where the output is printed
+ * @return int Returns -1 if the output could not be shown, else 0
+ */
+int jobs_output(char *task, FILE *stream) {
+  pthread_mutex_lock(&job_lock);
+  struct job_command *job = find_job(task);
+  if (job == NULL) {
+    pthread_mutex_unlock(&job_lock);
+    fprintf(stderr, ERROR_TASK_INVALID, task);
+    return -1;
+  }
+
+  int position = job->position;
+  enum Job_Status status = job->status;
+  pthread_mutex_unlock(&job_lock);
+
+  if (status == QUEUED) {
+    fprintf(stderr, ERROR_OUTPUT_QUEUED, position);
+    return -1;
+  } else if (status == RUNNING) {
+    fprintf(stderr, ERROR_OUTPUT_RUNNING, position);
+    return -1;
+  } else if (status == CANCELED) {
+    fprintf(stderr, ERROR_OUTPUT_CANCELED, position);
+    return -1;
+  }
+
+  // A complete job's output file is never written to again
+  int fd = open(job->output_file, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    fprintf(stderr, ERROR_EXEC_INFILE, strerror(errno));
+    return -1;
+  }
+  char buf[BUFSIZ];
+  ssize_t len;
+  while ((len = read(fd, buf, sizeof(buf))) > 0) {
+    if (fwrite(buf, 1, len, stream) != (size_t)len) {
+      break;
+    }
+  }
+  close(fd);
+  return 0;
+}
+
+/**
+ * @brief Cancels a job. A queued job is never started, a running job is sent a
+ * kill signal.
+ *
+ * @param task The task number typed on the command line
+ * @param stream Where the result is printed
+ * @return int Returns -1 if the job could not be canceled, else 0
+ */
+int jobs_cancel(char *task, FILE *stream) {
+  int result = 0;
+  if (check_not_forked("cancel") == -1) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&job_lock);
+  struct job_command *job = find_job(task);
+  if (job == NULL) {
+    fprintf(stderr, ERROR_TASK_INVALID, task);
+    result = -1;
+  } else if (job->status == QUEUED) {
+    cancel_queued(job);
+    fprintf(stream, MSG_CANCEL_OK, job->position);
+    wake_dispatcher(); // Tasks queued after it are canceled too
+  } else if (job->status == RUNNING && job->worker != NULL) {
+    fprintf(stream, MSG_CANCEL_REMOTE, job->position, job->worker->path);
+    shutdown(job->socket, SHUT_WR); // The worker kills a job whose shell hangs up
+  } else if (job->status == RUNNING) {
+    fprintf(stream, MSG_CANCEL_KILL, job->position, job->process_id);
+    kill(job->process_id, SIGKILL); // Not reaped yet, so the pid is still ours
+  } else {
+    fprintf(stderr, ERROR_CANCEL_DONE, job->position, job->position);
+    result = -1;
+  }
+  pthread_mutex_unlock(&job_lock);
+  return result;
+}
+
+/**
+ * @brief Called when the shell exits. Waits for every queued and running job to
+ * finish, so a script that queues work and reaches its end still has all of its
+ * work done, then removes the output files.
+ */
+void jobs_shutdown(void) {
+  pthread_mutex_lock(&job_lock);
+  if (!dispatcher_started) {
+    pthread_mutex_unlock(&job_lock);
+    return;
+  }
+  while (num_queued > 0 || num_running > 0) {
+    pthread_cond_wait(&job_finished, &job_lock);
+  }
+
+  struct list_head *curr;
+  for (curr = job_queue.next; curr != &job_queue; curr = curr->next) {
+    struct job_command *job = list_entry(curr, struct job_command, queue);
+    unlink(job->output_file);
+  }
+  rmdir(output_dir);
+  pthread_mutex_unlock(&job_lock);
+}
+
+/**
+ * @brief Checks whether any job has ever been queued. Once one has, the shell has to
+ * call jobs_shutdown before it goes away.
+ *
+ * @return int 1 if a job has been queued, else 0
+ */
+int jobs_started(void) {
+  pthread_mutex_lock(&job_lock);
+  int started = dispatcher_started;
+  pthread_mutex_unlock(&job_lock);
+  return started;
+}
+
+/**
+ * @brief Adds a worker that queued jobs can be sent to.
+ *
+ * @param path The worker's socket
+ * @return int The number of jobs the worker runs at once, or -1 if it did not answer
+ */
+int jobs_add_worker(char *path) {
+  if (check_not_forked("worker add") == -1) {
+    return -1;
+  }
+  int slots = worker_hello(path);
+  if (slots == -1) {
+    fprintf(stderr, ERROR_WORKER_CONNECT, path, strerror(errno));
+    return -1;
+  }
+
+  pthread_mutex_lock(&job_lock);
+  struct job_worker *worker = calloc(1, sizeof(struct job_worker));
+  worker->path = strdup(path);
+  worker->slots = slots;
+  workers = realloc(workers, (num_workers + 1) * sizeof(struct job_worker *));
+  workers[num_workers++] = worker;
+  if (dispatcher_started) {
+    wake_dispatcher(); // Queued jobs may fit now
+  }
+  pthread_mutex_unlock(&job_lock);
+  return slots;
+}
+
+/**
+ * @brief Prints every worker and how many of its slots are in use.
+ *
+ * @param stream Where the workers are printed
+ */
+void jobs_workers(FILE *stream) {
+  char *text = NULL;
+  size_t size = 0;
+  FILE *out = open_memstream(&text, &size);
+  if (out == NULL) {
+    out = stream;
+  }
+
+  pthread_mutex_lock(&job_lock);
+  for (int i = 0; i < num_workers; i++) {
+    fprintf(out, MSG_WORKER, workers[i]->path, workers[i]->running, workers[i]->slots);
+  }
+  pthread_mutex_unlock(&job_lock);
+  flush_status(out, stream, &text, &size);
+}
@@ -0,0 +1,18 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdio.h>
+
+#include "datastructures.h"
+
+void jobs_init(void);
+int jobs_queue(char **exec_args, char **env, int *after, int num_after);
+void jobs_status(FILE *stream);
+int jobs_output(char *task, FILE *stream);
+int jobs_cancel(char *task, FILE *stream);
+void jobs_shutdown(void);
+int jobs_started(void);
+int jobs_add_worker(char *path);
+void jobs_workers(FILE *stream);
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file linereader.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Reads scripts, the rc file and standard input a line at a time. Input is 
+ * read with large reads straight into one buffer and lines are handed out in place, 
+ * so there is no limit on how long a line can be. 
+ * @version 0.1
+ * @date 2021-04-16
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <errno.h> // for EINTR
+#include <stdlib.h> // for memory allocation
+#include <string.h> // for memchr
+#include <sys/stat.h> // for fstat
+#include <unistd.h> // for read
+
+#include "linereader.h"
+
+/**
+ * @brief Starts reading lines from a file descriptor. 
+ * 
+ * @param reader The reader being set up
+ * @param fd The file descriptor lines are read from, it is not closed by the reader
+ */
+void line_reader_open_fd(struct line_reader *reader, int fd) {
+  reader->fd = fd; 
+  reader->size = READ_CHUNK; 
+  reader->buf = malloc(reader->size); 
+  reader->start = 0; 
+  reader->end = 0; 
+  reader->eof = 0; 
+}
+
+/**
+ * @brief Starts reading lines from a string, such as the one given to sush -c. 
+ * 
+ * @param reader The reader being set up
+ * @param string The lines, it is copied
+ */
+void line_reader_open_string(struct line_reader *reader, const char *string) {
+  reader->fd = -1; 
+  reader->end = strlen(string); 
+  reader->size = reader->end + 1; 
+  reader->buf = malloc(reader->size); 
+  memcpy(reader->buf, string, reader->end); 
+  reader->start = 0; 
+  reader->eof = 1; 
+}
+
+/**
+ * @brief Reads more input onto the end of the buffer. Input that has already been 
+ * handed out is dropped first, and the buffer is doubled if it is still full. 
+ * 
+ * @param reader The reader
+ * @return int Returns the number of bytes read, 0 at the end of the input
+ */
+static int fill(struct line_reader *reader) {
+  if (reader->eof) {
+    return 0; 
+  }
+
+  if (reader->start > 0) { // Make room by moving the unread input to the front
+    memmove(reader->buf, reader->buf + reader->start, reader->end - reader->start); 
+    reader->end -= reader->start; 
+    reader->start = 0; 
+  }
+  if (reader->size - reader->end < READ_CHUNK) {
+    reader->size *= 2; 
+    reader->buf = realloc(reader->buf, reader->size); 
+  }
+
+  ssize_t got; 
+  do {
+    got = read(reader->fd, reader->buf + reader->end, reader->size - reader->end - 1); 
+  } while (got == -1 && errno == EINTR); 
+
+  if (got <= 0) {
+    reader->eof = 1; 
+    return 0; 
+  }
+  reader->end += got; 
+  return got; 
+}
+
+/**
+ * @brief Gets the next line. The newline is removed and the line is null terminated 
+ * in the reader's buffer, so it is only good until the next call. 
+ * 
+ * @param reader The reader
+ * @return char* The line, or NULL once there are no lines left
+ */
+char * line_reader_next(struct line_reader *reader) {
+  size_t scanned = 0; // Bytes after start that are known to have no newline
+  char *newline; 
+
+  while ((newline = memchr(reader->buf + reader->start + scanned, '\n', reader->end - reader->start - scanned)) == NULL) {
+    scanned = reader->end - reader->start; 
+    if (fill(reader) == 0) {
+      if (reader->start == reader->end) {
+        return NULL; 
+      }
+      newline = reader->buf + reader->end; // Last line has no newline
+      reader->end++; // Room was left for the null terminator
+      break; 
+    }
+  }
+
+  char *line = reader->buf + reader->start; 
+  *newline = '\0'; 
+  reader->start = newline - reader->buf + 1; 
+  return line; 
+}
+
+/**
+ * @brief Checks whether every line has been handed out, without reading or moving 
+ * the line last handed out. Only a string or a regular file can be known to be 
+ * finished ahead of time, anything else, like a pipe, never reports the end. 
+ * 
+ * @param reader The reader
+ * @return int 1 if there are no lines left, else 0
+ */
+int line_reader_at_end(struct line_reader *reader) {
+  if (reader->start < reader->end) {
+    return 0; 
+  } else if (reader->eof) {
+    return 1; 
+  }
+
+  struct stat sb; 
+  if (fstat(reader->fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+    return 0; 
+  }
+  return lseek(reader->fd, 0, SEEK_CUR) >= sb.st_size; 
+}
+
+/**
+ * @brief Frees the reader's buffer. The file descriptor is left open. 
+ * 
+ * @param reader The reader
+ */
+void line_reader_close(struct line_reader *reader) {
+  free(reader->buf); 
+  reader->buf = NULL; 
+}
@@ -0,0 +1,34 @@
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <stddef.h>
+
+#define READ_CHUNK 65536 // Bytes asked for by each read
+
+/**
+ * @brief Splits a file or a string into lines. Input is read in large chunks and a 
+ * line can be any length, the buffer grows to hold it. 
+ * 
+ * @param fd The file descriptor read from, -1 when reading a string
+ * @param buf Holds input that has been read but not handed out yet
+ * @param size Bytes buf has room for
+ * @param start Where the next line starts in buf
+ * @param end Where the input read so far ends in buf
+ * @param eof Set once there is nothing left to read
+ */
+struct line_reader {
+    int fd; 
+    char *buf; 
+    size_t size; 
+    size_t start; 
+    size_t end; 
+    int eof; 
+}; 
+
+void line_reader_open_fd(struct line_reader *reader, int fd); 
+void line_reader_open_string(struct line_reader *reader, const char *string); 
+char * line_reader_next(struct line_reader *reader); 
+int line_reader_at_end(struct line_reader *reader); 
+void line_reader_close(struct line_reader *reader); 
+
+#endif
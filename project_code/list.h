@@ -8,6 +8,10 @@
 
 #define LIST_HEAD(name) struct list_head name = LIST_HEAD_INIT(name)
 
+#define INIT_LIST_HEAD(ptr) do { \
+   (ptr)->next = (ptr); (ptr)->prev = (ptr); \
+     } while (0)
+
 #define list_entry(ptr, type, member) ({ \
    void *__mptr = (void *)(ptr);        \
    ((type *)(__mptr - offsetof(type, member)));  \
@@ -0,0 +1,399 @@
+/**
+ * @file parallel.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief The parallel internal command, which runs a command once for every input,
+ * keeping a number of them running at once.
+ *
+ *   parallel [-j jobs] [-k] [-0] command args... [::: inputs...]
+ *
+ * {} in the args is replaced by the input, if no arg has {} the input is added to the
+ * end. Without ::: the inputs are the lines of the input, or NUL separated with -0.
+ * -j sets how many commands run at once, by default one per core, and can also be
+ * written -j4. As soon as one exits the next is started. The commands write straight
+ * to the output, with -k each one's output is kept in a memfd and copied out in the
+ * order of the inputs.
+ * @version 0.1
+ * @date 2021-04-23
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#define _GNU_SOURCE
+#include <errno.h> // for errno
+#include <fcntl.h> // for open
+#include <poll.h> // for poll
+#include <stdio.h> // for fprintf
+#include <stdlib.h> // for memory allocation
+#include <string.h> // for string handling
+#include <unistd.h> // for read, lseek and close
+#include <sys/mman.h> // for memfd_create
+#include <sys/pidfd.h> // for pidfd_open
+#include <sys/wait.h> // for waitpid
+
+#include "parallel.h"
+#include "environ.h"
+#include "executor.h"
+#include "copyfd.h"
+#include "error.h"
+
+#define PARALLEL_MAX_STATUS 101 // Exit code once this many commands have failed, as GNU parallel does
+#define PARALLEL_READ_SIZE 65536 // Bytes read at a time when the inputs come from the input
+
+/**
+ * @brief One run of the command.
+ *
+ * @param pid The process running it, -1 once it has been reaped
+ * @param out The memfd its output is kept in with -k, else -1
+ * @param status Its exit code
+ * @param done 1 once it has finished
+ */
+struct parallel_task {
+  pid_t pid;
+  int out;
+  int status;
+  int done;
+};
+
+/**
+ * @brief The options given to parallel.
+ *
+ * @param jobs How many commands run at once
+ * @param keep_order 1 to copy out each command's output in input order
+ * @param separator What the inputs read from the input are split on
+ * @param command The first arg of the command
+ * @param num_command The number of args of the command
+ */
+struct parallel_options {
+  long jobs;
+  int keep_order;
+  char separator;
+  char **command;
+  int num_command;
+};
+
+/**
+ * @brief Reads the options at the start of the args.
+ *
+ * @param args The args after parallel
+ * @param options Set from the args
+ * @return int The number of args used, -1 if they are wrong
+ */
+static int parse_options(char **args, struct parallel_options *options) {
+  int i = 0;
+  options->jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  options->keep_order = 0;
+  options->separator = '\n';
+  for (; args[i] != NULL && args[i][0] == '-'; i++) {
+    if (strcmp(args[i], "-k") == 0) {
+      options->keep_order = 1;
+    } else if (strcmp(args[i], "-0") == 0) {
+      options->separator = '\0';
+    } else if (strncmp(args[i], "-j", 2) == 0 && (args[i][2] != '\0' || args[i + 1] != NULL)) {
+      char *count = args[i][2] != '\0' ? args[i] + 2 : args[++i]; // -j4 or -j 4
+      char *end;
+      options->jobs = strtol(count, &end, 10);
+      if (end == count || *end != '\0' || options->jobs < 1) {
+        return -1;
+      }
+    } else {
+      return -1;
+    }
+  }
+  if (options->jobs < 1) {
+    options->jobs = 1;
+  }
+  return i;
+}
+
+/**
+ * @brief Reads every input from a file descriptor.
+ *
+ * @param fd Where the inputs are read from
+ * @param separator What ends each input
+ * @param buffer Set to the memory the inputs are in, freed by the caller
+ * @param num_inputs Set to the number of inputs
+ * @return char** The inputs, freed by the caller, or NULL if reading failed
+ */
+static char **read_inputs(int fd, char separator, char **buffer, int *num_inputs) {
+  size_t size = 0;
+  size_t capacity = PARALLEL_READ_SIZE;
+  char *data = malloc(capacity + 1);
+  ssize_t got;
+  while ((got = read(fd, data + size, capacity - size)) != 0) {
+    if (got == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      free(data);
+      return NULL;
+    }
+    size += got;
+    if (size == capacity) {
+      capacity *= 2;
+      data = realloc(data, capacity + 1);
+    }
+  }
+  if (size > 0 && data[size - 1] != separator) { // The last input may not be ended
+    data[size++] = separator;
+  }
+
+  int count = 0;
+  for (size_t i = 0; i < size; i++) {
+    count += data[i] == separator;
+  }
+  char **inputs = malloc((count + 1) * sizeof(char *));
+  char *start = data;
+  count = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (data[i] == separator) {
+      data[i] = '\0';
+      inputs[count++] = start;
+      start = data + i + 1;
+    }
+  }
+  *buffer = data;
+  *num_inputs = count;
+  return inputs;
+}
+
+/**
+ * @brief Replaces every {} in an arg with the input.
+ *
+ * @param arg The arg from the command
+ * @param input The input
+ * @return char* The new arg, freed by the caller
+ */
+static char *replace_input(const char *arg, const char *input) {
+  size_t input_length = strlen(input);
+  size_t length = 0;
+  for (const char *c = arg; *c != '\0'; c++) {
+    if (c[0] == '{' && c[1] == '}') {
+      length += input_length;
+      c++;
+    } else {
+      length++;
+    }
+  }
+
+  char *result = malloc(length + 1);
+  char *out = result;
+  for (const char *c = arg; *c != '\0'; c++) {
+    if (c[0] == '{' && c[1] == '}') {
+      memcpy(out, input, input_length);
+      out += input_length;
+      c++;
+    } else {
+      *out++ = *c;
+    }
+  }
+  *out = '\0';
+  return result;
+}
+
+/**
+ * @brief Starts the command for one input.
+ *
+ * @param options The command and how its output is kept
+ * @param input The input
+ * @param env The environment the command gets
+ * @param in The file descriptor the command reads from
+ * @param out The file descriptor the command writes to without -k
+ * @param task Set to the started command
+ * @return int 0 if it started, else -1
+ */
+static int start_task(struct parallel_options *options, char *input, char **env, int in, int out, struct parallel_task *task) {
+  char **args = calloc(options->num_command + 2, sizeof(char *));
+  int replaced = 0;
+  for (int i = 0; i < options->num_command; i++) {
+    replaced |= strstr(options->command[i], "{}") != NULL;
+    args[i] = replace_input(options->command[i], input);
+  }
+  if (!replaced) {
+    args[options->num_command] = strdup(input);
+  }
+
+  task->out = -1;
+  task->pid = -1;
+  task->status = 0;
+  task->done = 0;
+  if (options->keep_order) {
+    task->out = memfd_create("parallel", MFD_CLOEXEC);
+    if (task->out == -1) {
+      fprintf(stderr, ERROR_PARALLEL_START, args[0], strerror(errno));
+    }
+  }
+  if (!options->keep_order || task->out != -1) {
+    task->pid = spawn_command(args, env, in, options->keep_order ? task->out : out, STDERR_FILENO);
+    if (task->pid == -1) {
+      fprintf(stderr, ERROR_CMD_NOT_FOUND, args[0]);
+    }
+  }
+
+  for (int i = 0; i <= options->num_command; i++) {
+    free(args[i]);
+  }
+  free(args);
+  if (task->pid == -1) {
+    task->status = 127;
+    task->done = 1;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Reaps a command that has exited.
+ *
+ * @param task The command
+ */
+static void finish_task(struct parallel_task *task) {
+  int status;
+  pid_t result;
+  while ((result = waitpid(task->pid, &status, 0)) == -1 && errno == EINTR) {
+    continue;
+  }
+  task->status = result == -1 ? 127 : exit_code_from_status(status);
+  task->pid = -1;
+  task->done = 1;
+}
+
+/**
+ * @brief Copies out the kept output of every finished command that is next in order.
+ *
+ * @param tasks Every command
+ * @param num_tasks The number of commands
+ * @param next The first command whose output has not been copied, moved past what is copied
+ * @param out Where the output goes
+ */
+static void copy_finished(struct parallel_task *tasks, int num_tasks, int *next, int out) {
+  for (; *next < num_tasks && tasks[*next].done; (*next)++) {
+    struct parallel_task *task = &tasks[*next];
+    if (task->out == -1) {
+      continue;
+    }
+    if (lseek(task->out, 0, SEEK_SET) == 0 && copy_fd(task->out, out) == -1 && errno != EPIPE) {
+      fprintf(stderr, ERROR_COPY_FAILED, "parallel output", strerror(errno));
+    }
+    close(task->out);
+    task->out = -1;
+  }
+}
+
+/**
+ * @brief Handles the parallel internal command, see the top of this file.
+ *
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables, passed to every command
+ * @param io Where the inputs may come from and the output goes
+ * @return int The number of commands that failed, up to 101, or -1 if the args are wrong
+ */
+int handle_parallel(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  struct parallel_options options;
+  char **args = subcommand->exec_args + 1;
+  int used = parse_options(args, &options);
+  if (used == -1 || args[used] == NULL || strcmp(args[used], ":::") == 0) {
+    fprintf(stderr, ERROR_PARALLEL_USAGE);
+    return -1;
+  }
+  options.command = args + used;
+  options.num_command = 0;
+  while (options.command[options.num_command] != NULL && strcmp(options.command[options.num_command], ":::") != 0) {
+    options.num_command++;
+  }
+
+  char **inputs;
+  char *buffer = NULL;
+  int num_inputs = 0;
+  int in = io->in;
+  if (options.command[options.num_command] != NULL) { // parallel command ::: inputs...
+    inputs = options.command + options.num_command + 1;
+    while (inputs[num_inputs] != NULL) {
+      num_inputs++;
+    }
+  } else {
+    inputs = read_inputs(io->in, options.separator, &buffer, &num_inputs);
+    if (inputs == NULL) {
+      fprintf(stderr, ERROR_PARALLEL_INPUT, strerror(errno));
+      return -1;
+    }
+    in = open("/dev/null", O_RDONLY | O_CLOEXEC); // The input has been used up
+    if (in == -1) {
+      in = io->in;
+    }
+  }
+
+  fflush(io->stream); // Anything printed before goes first
+  char **env = get_env_array(list_env);
+  struct parallel_task *tasks = calloc(num_inputs > 0 ? num_inputs : 1, sizeof(struct parallel_task));
+  struct pollfd *polls = calloc(options.jobs, sizeof(struct pollfd));
+  int *running = calloc(options.jobs, sizeof(int)); // Which task each poll entry watches
+  int num_running = 0;
+  int next = 0;
+  int next_copied = 0;
+
+  while (next < num_inputs || num_running > 0) {
+    // Keep every slot busy
+    while (num_running < options.jobs && next < num_inputs) {
+      struct parallel_task *task = &tasks[next];
+      if (start_task(&options, inputs[next], env, in, io->out, task) == 0) {
+        int pidfd = pidfd_open(task->pid, 0);
+        if (pidfd == -1) { // Without pidfds the command runs to the end on its own
+          finish_task(task);
+        } else {
+          polls[num_running].fd = pidfd;
+          polls[num_running].events = POLLIN;
+          running[num_running++] = next;
+        }
+      }
+      next++;
+    }
+    if (options.keep_order) {
+      copy_finished(tasks, num_inputs, &next_copied, io->out);
+    }
+    if (num_running == 0) {
+      continue;
+    }
+
+    if (poll(polls, num_running, -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      for (int i = 0; i < num_running; i++) { // Fall back to waiting in order
+        finish_task(&tasks[running[i]]);
+        close(polls[i].fd);
+      }
+      num_running = 0;
+      continue;
+    }
+    for (int i = 0; i < num_running; i++) {
+      if (polls[i].revents != 0) {
+        finish_task(&tasks[running[i]]);
+        close(polls[i].fd);
+        polls[i] = polls[--num_running]; // The last one fills the slot
+        running[i] = running[num_running];
+        i--;
+      }
+    }
+  }
+  if (options.keep_order) {
+    copy_finished(tasks, num_inputs, &next_copied, io->out);
+  }
+
+  int failed = 0;
+  for (int i = 0; i < num_inputs; i++) {
+    failed += tasks[i].status != 0;
+  }
+  if (buffer != NULL) {
+    free(buffer);
+    free(inputs);
+    if (in != io->in) {
+      close(in);
+    }
+  }
+  free(tasks);
+  free(polls);
+  free(running);
+  return failed < PARALLEL_MAX_STATUS ? failed : PARALLEL_MAX_STATUS;
+}
@@ -0,0 +1,9 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "datastructures.h"
+#include "internal.h"
+
+int handle_parallel(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+
+#endif
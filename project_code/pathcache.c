@@ -0,0 +1,303 @@
+/**
+ * @file pathcache.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Remembers where commands were found on PATH, so a command is only searched
+ * for the first time it is run. Commands that were not found are remembered too, so
+ * they fail without forking. The cache is emptied whenever PATH changes.
+ * @version 0.1
+ * @date 2021-04-10
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#define _GNU_SOURCE
+#include <errno.h> // for errno
+#include <pthread.h> // for the cache lock
+#include <stdio.h> // for printf
+#include <stdlib.h> // for memory allocation
+#include <string.h> // for handling strings
+#include <sys/stat.h> // for stat
+#include <unistd.h> // for access
+
+#include "pathcache.h"
+
+#define CACHE_MIN_CAPACITY 64 // Smallest number of slots in the cache, a power of two
+
+/**
+ * @brief A command that has been searched for.
+ *
+ * @param name The name typed on the command line
+ * @param path Where the command was found, NULL if it was not found
+ * @param hash Hash of name
+ */
+struct path_entry {
+  char *name;
+  char *path;
+  unsigned long hash;
+};
+
+/**
+ * @brief Open addressing hash table of commands. Entries are only ever removed all
+ * at once, so there are no tombstones. The job dispatcher looks commands up from its
+ * own thread, so the table is guarded by a lock.
+ */
+static struct path_cache {
+  struct path_entry *slots; // Slots with a NULL name are empty
+  unsigned long capacity;
+  unsigned long count;
+  char *path; // The PATH the entries were found with
+} cache;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Hashes a command name with 64 bit FNV-1a.
+ *
+ * @param name The name being hashed
+ * @return unsigned long The hash of the name
+ */
+static unsigned long hash_command(const char *name) {
+  unsigned long hash = 14695981039346656037UL;
+  while (*name != '\0') {
+    hash ^= (unsigned char)*name++;
+    hash *= 1099511628211UL;
+  }
+  return hash;
+}
+
+/**
+ * @brief Empties the cache. Must be called with cache_lock held.
+ */
+static void clear_locked(void) {
+  for (unsigned long i = 0; i < cache.capacity; i++) {
+    free(cache.slots[i].name);
+    free(cache.slots[i].path);
+  }
+  free(cache.slots);
+  free(cache.path);
+  memset(&cache, 0, sizeof(cache));
+}
+
+/**
+ * @brief Empties the cache if PATH has changed since the entries were found, since
+ * they may be wrong now. Must be called with cache_lock held.
+ *
+ * @param path The value of PATH, NULL if it is not set
+ */
+static void check_path_locked(const char *path) {
+  if (path == NULL) {
+    path = "";
+  }
+  if (cache.path == NULL || strcmp(cache.path, path) != 0) {
+    clear_locked();
+    cache.path = strdup(path);
+  }
+}
+
+/**
+ * @brief Finds the slot for a command, either the slot it is in or the empty slot it
+ * would go in. Must be called with cache_lock held and a non empty table.
+ *
+ * @param name The name of the command
+ * @param hash The hash of name
+ * @return struct path_entry* The slot for the command
+ */
+static struct path_entry *find_slot(const char *name, unsigned long hash) {
+  unsigned long mask = cache.capacity - 1;
+  unsigned long i = hash & mask;
+  while (cache.slots[i].name != NULL) {
+    if (cache.slots[i].hash == hash && strcmp(cache.slots[i].name, name) == 0) {
+      break;
+    }
+    i = (i + 1) & mask;
+  }
+  return &cache.slots[i];
+}
+
+/**
+ * @brief Doubles the size of the table once it is half full. Must be called with
+ * cache_lock held.
+ */
+static void grow_if_needed(void) {
+  if ((cache.count + 1) * 2 <= cache.capacity) {
+    return;
+  }
+
+  struct path_entry *old = cache.slots;
+  unsigned long old_capacity = cache.capacity;
+  cache.capacity = old_capacity ? old_capacity * 2 : CACHE_MIN_CAPACITY;
+  cache.slots = calloc(cache.capacity, sizeof(struct path_entry));
+  for (unsigned long i = 0; i < old_capacity; i++) {
+    if (old[i].name != NULL) {
+      *find_slot(old[i].name, old[i].hash) = old[i];
+    }
+  }
+  free(old);
+}
+
+/**
+ * @brief Searches every directory on PATH for a command the same way execvp does.
+ * An empty directory in PATH means the current directory.
+ *
+ * @param command The name of the command
+ * @param path The value of PATH
+ * @return char* The full path to the command, or NULL if it was not found
+ */
+static char *search_path(const char *command, const char *path) {
+  int command_len = strlen(command);
+  const char *dir = path;
+
+  while (1) {
+    const char *end = strchrnul(dir, ':');
+    int dir_len = end - dir;
+    char *candidate = malloc(dir_len + command_len + 3);
+
+    if (dir_len == 0) { // Empty entry, look in the current directory
+      strcpy(candidate, "./");
+    } else {
+      memcpy(candidate, dir, dir_len);
+      candidate[dir_len] = '/';
+      candidate[dir_len + 1] = '\0';
+    }
+    strcat(candidate, command);
+
+    struct stat sb;
+    if (stat(candidate, &sb) == 0 && S_ISREG(sb.st_mode) && access(candidate, X_OK) == 0) {
+      return candidate;
+    }
+    free(candidate);
+
+    if (*end == '\0') {
+      return NULL;
+    }
+    dir = end + 1;
+  }
+}
+
+/**
+ * @brief Finds the full path of a command. A command with a slash in it is used as
+ * it is, anything else is looked up in the cache and searched for on PATH if it has
+ * not been seen since PATH last changed.
+ *
+ * @param command The name of the command
+ * @param path The value of PATH, NULL if it is not set
+ * @return char* A copy of the full path that the caller frees, or NULL if the
+ * command was not found (errno is set to ENOENT)
+ */
+char * path_cache_lookup(const char *command, const char *path) {
+  if (strchr(command, '/') != NULL) {
+    return strdup(command);
+  }
+  if (path == NULL) {
+    path = "";
+  }
+
+  pthread_mutex_lock(&cache_lock);
+  check_path_locked(path);
+  grow_if_needed();
+  unsigned long hash = hash_command(command);
+  struct path_entry *entry = find_slot(command, hash);
+  if (entry->name == NULL) { // Not seen before, search for it and remember the answer
+    entry->name = strdup(command);
+    entry->hash = hash;
+    entry->path = search_path(command, path);
+    cache.count++;
+  }
+
+  char *found = entry->path != NULL ? strdup(entry->path) : NULL;
+  pthread_mutex_unlock(&cache_lock);
+
+  if (found == NULL) {
+    errno = ENOENT;
+  }
+  return found;
+}
+
+/**
+ * @brief Searches for a command and adds it to the cache, even if it is already there.
+ *
+ * @param command The name of the command
+ * @param path The value of PATH, NULL if it is not set
+ * @return int Returns -1 if the command was not found, else 0
+ */
+int path_cache_add(const char *command, const char *path) {
+  // Drop what is cached for the command so it is searched for again
+  pthread_mutex_lock(&cache_lock);
+  check_path_locked(path);
+  if (cache.count > 0) {
+    struct path_entry *entry = find_slot(command, hash_command(command));
+    if (entry->name != NULL) {
+      free(entry->path);
+      entry->path = search_path(command, path);
+    }
+  }
+  pthread_mutex_unlock(&cache_lock);
+
+  char *found = path_cache_lookup(command, path);
+  int result = found == NULL ? -1 : 0;
+  free(found);
+  return result;
+}
+
+/**
+ * @brief Takes cache_lock before a fork, so the child never gets it locked by a
+ * thread it does not have.
+ */
+static void lock_before_fork(void) {
+  pthread_mutex_lock(&cache_lock);
+}
+
+/**
+ * @brief Gives back cache_lock after a fork, in the shell and in the child.
+ */
+static void unlock_after_fork(void) {
+  pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * @brief Sets up the cache, must be called once before any thread is started and
+ * before jobs_init, so a fork takes job_lock before cache_lock as the job dispatcher does.
+ */
+void path_cache_init(void) {
+  pthread_atfork(lock_before_fork, unlock_after_fork, unlock_after_fork);
+}
+
+/**
+ * @brief Empties the cache, every command is searched for again the next time it runs.
+ */
+void path_cache_clear(void) {
+  pthread_mutex_lock(&cache_lock);
+  clear_locked();
+  pthread_mutex_unlock(&cache_lock);
+}
+
+/**
+ * @brief Prints every command in the cache and where it was found.
+ *
+ * @param path The value of PATH, NULL if it is not set
+ * @param stream Where the commands are printed
+ */
+void path_cache_display(const char *path, FILE *stream) {
+  char *text = NULL;
+  size_t size = 0;
+  FILE *out = open_memstream(&text, &size); // Written once cache_lock is let go, a full pipe must not hold it
+  if (out == NULL) {
+    out = stream;
+  }
+
+  pthread_mutex_lock(&cache_lock);
+  check_path_locked(path);
+  for (unsigned long i = 0; i < cache.capacity; i++) {
+    if (cache.slots[i].name != NULL) {
+      fprintf(out, "%s\t%s\n", cache.slots[i].name,
+             cache.slots[i].path != NULL ? cache.slots[i].path : "(not found)");
+    }
+  }
+  pthread_mutex_unlock(&cache_lock);
+  if (out != stream) {
+    fclose(out);
+    fwrite(text, 1, size, stream);
+  }
+  free(text);
+}
@@ -0,0 +1,12 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+#include <stdio.h>
+
+void path_cache_init(void);
+char * path_cache_lookup(const char *command, const char *path);
+int path_cache_add(const char *command, const char *path);
+void path_cache_clear(void);
+void path_cache_display(const char *path, FILE *stream);
+
+#endif
@@ -0,0 +1,310 @@
+/**
+ * @file pipepart.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief The pipepart prefix, which runs several copies of a pipeline at once, each
+ * on its own part of the input file.
+ *
+ *   pipepart [-j copies] command args... < file | command...
+ *
+ * The file is split at line boundaries into one byte range per copy, by default one
+ * per core. The kernel moves each range from the file into its copy's input pipe, so
+ * the file is never copied by the shell or saved anywhere else. Each copy's output is
+ * kept in a memfd and written out in the order of the ranges, so the output is the
+ * same as one copy would give for line by line commands like grep. A redirect of the
+ * last command's output is opened once by the shell, which writes the memfds to it.
+ * @version 0.1
+ * @date 2021-04-24
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#define _GNU_SOURCE
+#include <errno.h> // for errno
+#include <fcntl.h> // for open
+#include <pthread.h> // for the threads feeding the copies
+#include <signal.h> // for the signal mask
+#include <stdio.h> // for fprintf
+#include <stdlib.h> // for memory allocation
+#include <string.h> // for string handling
+#include <unistd.h> // for fork, pread and close
+#include <sys/mman.h> // for memfd_create
+#include <sys/stat.h> // for fstat
+#include <sys/wait.h> // for waitpid
+
+#include "pipepart.h"
+#include "executor.h"
+#include "copyfd.h"
+#include "error.h"
+
+#define BOUNDARY_READ_SIZE 4096 // Bytes read at a time looking for the end of a line
+
+/**
+ * @brief One copy of the pipeline and the part of the file it reads.
+ *
+ * @param file The input file, shared by every range
+ * @param start Where the range starts in the file
+ * @param length How many bytes the range has
+ * @param in The write end of the copy's input pipe, -1 once closed
+ * @param out The memfd the copy's output is kept in
+ * @param pid The forked copy of the shell running the pipeline
+ * @param feeding 1 while a thread is moving the range into the pipe
+ * @param thread The thread moving the range
+ */
+struct pipepart_range {
+  int file;
+  off_t start;
+  off_t length;
+  int in;
+  int out;
+  pid_t pid;
+  int feeding;
+  pthread_t thread;
+};
+
+/**
+ * @brief Takes pipepart and its options off the front of a parsed line.
+ *
+ * @param cmdline The parsed line
+ * @param list_commands The subcommands of the line
+ * @param copies Set to how many copies of the pipeline to run
+ * @return int 1 if the line starts with pipepart, 0 if not, -1 if it is used wrong
+ */
+int pipepart_prefix(commandline *cmdline, struct list_head *list_commands, long *copies) {
+  struct subcommand *first = list_entry(list_commands->next, struct subcommand, list);
+  if (cmdline->num == 0 || strcmp(first->exec_args[0], "pipepart") != 0) {
+    return 0;
+  }
+
+  first->exec_args++;
+  *copies = sysconf(_SC_NPROCESSORS_ONLN);
+  if (first->exec_args[0] != NULL && strcmp(first->exec_args[0], "-j") == 0) {
+    char *end;
+    *copies = first->exec_args[1] == NULL ? 0 : strtol(first->exec_args[1], &end, 10);
+    if (*copies < 1 || *end != '\0') {
+      fprintf(stderr, ERROR_PIPEPART_USAGE);
+      return -1;
+    }
+    first->exec_args += 2;
+  }
+  if (first->exec_args[0] == NULL || first->input_type != REDIRECT_INPUT) {
+    fprintf(stderr, ERROR_PIPEPART_USAGE);
+    return -1;
+  }
+  if (*copies < 1) {
+    *copies = 1;
+  }
+  return 1;
+}
+
+/**
+ * @brief Finds where the line that a byte is in ends.
+ *
+ * @param fd The file
+ * @param offset The byte
+ * @param size The size of the file
+ * @return off_t The offset just past the line's newline, or size if there is none
+ */
+static off_t line_end(int fd, off_t offset, off_t size) {
+  char buf[BOUNDARY_READ_SIZE];
+  while (offset < size) {
+    ssize_t got = pread(fd, buf, sizeof(buf), offset);
+    if (got == -1 && errno == EINTR) {
+      continue;
+    } else if (got <= 0) {
+      break;
+    }
+    char *newline = memchr(buf, '\n', got);
+    if (newline != NULL) {
+      return offset + (newline - buf) + 1;
+    }
+    offset += got;
+  }
+  return size;
+}
+
+/**
+ * @brief Splits a file into ranges that each end at the end of a line.
+ *
+ * @param fd The file
+ * @param size The size of the file
+ * @param copies How many ranges are wanted
+ * @param ranges Filled with the ranges, there is room for copies of them
+ * @return int The number of ranges, fewer than copies if the lines are long
+ */
+static int split_file(int fd, off_t size, long copies, struct pipepart_range *ranges) {
+  int num_ranges = 0;
+  off_t start = 0;
+  for (long i = 1; i <= copies && start < size; i++) {
+    off_t end = i == copies ? size : size / copies * i;
+    if (end <= start) {
+      continue;
+    }
+    end = i == copies ? size : line_end(fd, end - 1, size);
+    ranges[num_ranges].file = fd;
+    ranges[num_ranges].start = start;
+    ranges[num_ranges].length = end - start;
+    num_ranges++;
+    start = end;
+  }
+  return num_ranges;
+}
+
+/**
+ * @brief Moves a range of the file into its copy's input pipe. SIGPIPE is blocked,
+ * so a copy that stops reading early only ends this thread.
+ *
+ * @param arg The pipepart_range being fed
+ * @return void* Always NULL
+ */
+static void *feed_range(void *arg) {
+  struct pipepart_range *range = arg;
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+  copy_range(range->file, range->start, range->length, range->in);
+  return NULL;
+}
+
+/**
+ * @brief Starts one copy of the pipeline in a forked copy of the shell, reading its
+ * range from a pipe and writing to a memfd.
+ *
+ * @param ranges Every range, those before this one already have their copy started
+ * @param index Which range the copy reads
+ * @param subcommand_count The number of subcommands in list_commands
+ * @param list_commands The pipeline
+ * @param list_env The list of environment variables
+ * @return int 0 on success, -1 if it could not be started
+ */
+static int start_copy(struct pipepart_range *ranges, int index, int subcommand_count, struct list_head *list_commands, struct list_head *list_env) {
+  struct pipepart_range *range = &ranges[index];
+  int fds[2];
+  range->in = -1;
+  range->pid = -1;
+  range->feeding = 0;
+  range->out = memfd_create("pipepart", MFD_CLOEXEC);
+  if (range->out == -1 || pipe2(fds, O_CLOEXEC) == -1) {
+    return -1;
+  }
+
+  range->pid = fork();
+  if (range->pid == 0) { // Child process
+    sigset_t empty;
+    sigemptyset(&empty);
+    sigprocmask(SIG_SETMASK, &empty, NULL);
+    signal(SIGPIPE, SIG_DFL);
+    for (int i = 0; i < index; i++) { // Other copies must see the end of their input
+      if (ranges[i].in != -1) {
+        close(ranges[i].in);
+      }
+    }
+    close(fds[1]);
+    dup2(fds[0], STDIN_FILENO);
+    dup2(range->out, STDOUT_FILENO);
+    _exit(run_forked_line(subcommand_count, list_commands, list_env));
+  }
+  close(fds[0]);
+  range->in = fds[1];
+  if (range->pid == -1) {
+    return -1;
+  }
+  range->feeding = pthread_create(&range->thread, NULL, feed_range, range) == 0;
+  return range->feeding ? 0 : -1;
+}
+
+/**
+ * @brief Runs a line that started with pipepart, see the top of this file.
+ *
+ * @param copies How many copies of the pipeline to run
+ * @param subcommand_count The number of subcommands in list_commands
+ * @param list_commands The pipeline, without pipepart
+ * @param list_env The list of environment variables
+ * @return int The first non zero exit code of a copy, else 0
+ */
+int run_pipepart(long copies, int subcommand_count, struct list_head *list_commands, struct list_head *list_env) {
+  struct subcommand *first = list_entry(list_commands->next, struct subcommand, list);
+  struct stat sb;
+  int fd = open(first->input, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    fprintf(stderr, ERROR_EXEC_INFILE, strerror(errno));
+    return 1;
+  }
+  if (fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode) || copies == 1) { // Nothing to split
+    close(fd);
+    return run_command(subcommand_count, list_commands, list_env);
+  }
+
+  struct pipepart_range *ranges = calloc(copies, sizeof(struct pipepart_range));
+  int num_ranges = split_file(fd, sb.st_size, copies, ranges);
+  if (num_ranges <= 1) {
+    free(ranges);
+    close(fd);
+    return run_command(subcommand_count, list_commands, list_env);
+  }
+
+  struct subcommand *last = list_entry(list_commands->prev, struct subcommand, list);
+  struct subcommand target = { .input_type = NORMAL, .output = last->output, .type = last->type };
+  int fds[2] = { STDIN_FILENO, STDOUT_FILENO };
+  if (open_redirect_files(&target, fds) == -1) {
+    free(ranges);
+    close(fd);
+    return 1;
+  }
+  int out = fds[1];
+
+  first->input_type = NORMAL; // Each copy reads its range from its stdin
+  first->input = NULL;
+  last->output = "stdout"; // Each copy writes to its memfd, the shell writes them to out
+  fflush(NULL); // Nothing buffered in the shell may be written twice
+  int started;
+  for (started = 0; started < num_ranges; started++) {
+    if (start_copy(ranges, started, subcommand_count, list_commands, list_env) == -1) {
+      fprintf(stderr, ERROR_PIPEPART_START, strerror(errno));
+      started++;
+      break;
+    }
+  }
+
+  // Every copy is started, so each pipe can be closed once its range is in it
+  int status = 0;
+  for (int i = 0; i < started; i++) {
+    struct pipepart_range *range = &ranges[i];
+    if (range->feeding) {
+      pthread_join(range->thread, NULL);
+    }
+    if (range->in != -1) {
+      close(range->in);
+    }
+  }
+  for (int i = 0; i < started; i++) {
+    struct pipepart_range *range = &ranges[i];
+    int copy_status = 1;
+    if (range->pid > 0) {
+      int wstatus;
+      pid_t result;
+      while ((result = waitpid(range->pid, &wstatus, 0)) == -1 && errno == EINTR) {
+        continue;
+      }
+      copy_status = result == -1 ? 1 : exit_code_from_status(wstatus);
+    }
+    if (status == 0) {
+      status = copy_status;
+    }
+    if (range->out != -1) {
+      if (lseek(range->out, 0, SEEK_SET) == 0) {
+        copy_fd(range->out, out);
+      }
+      close(range->out);
+    }
+  }
+  if (out != STDOUT_FILENO) {
+    close(out);
+  }
+  free(ranges);
+  close(fd);
+  return status;
+}
@@ -0,0 +1,10 @@
+#ifndef PIPEPART_H
+#define PIPEPART_H
+
+#include "datastructures.h"
+#include "list.h"
+
+int pipepart_prefix(commandline *cmdline, struct list_head *list_commands, long *copies); 
+int run_pipepart(long copies, int subcommand_count, struct list_head *list_commands, struct list_head *list_env); 
+
+#endif
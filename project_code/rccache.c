@@ -0,0 +1,412 @@
+/**
+ * @file rccache.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Saves the parsed .sushrc next to it, so later startups map the parsed
+ * commands in and run them without reading or parsing the rc file. The cache is only
+ * used while the rc file's path, modification time and size match the ones it was
+ * made from, and its format version matches this shell's.
+ *
+ * After the header and the rc file's path, the cache is an array of 32 bit words
+ * followed by every string the commands use. Each line is one word holding the
+ * number of subcommands (RC_CACHE_INVALID for a line that did not parse), then for
+ * each subcommand: the number of args, the redirect type, the input redirect type,
+ * the number of process substitutions, the input, the output, the args, then the
+ * arg, kind and command of each process substitution. A here-document's body is
+ * saved as its input. Strings are stored as their offset into the strings.
+ * @version 0.1
+ * @date 2021-04-17
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <stdio.h> // for snprintf
+#include <stdlib.h> // for memory allocation
+#include <string.h> // for string handling
+#include <fcntl.h> // for open
+#include <unistd.h> // for write and close
+#include <sys/mman.h> // for mmap
+
+#include "rccache.h"
+#include "arena.h"
+
+#define RC_CACHE_MAGIC "SUSHRC\0" // First bytes of every cache file
+#define RC_CACHE_INVALID 0xffffffffu // Number of subcommands saved for a line that did not parse
+#define RC_CACHE_BACKGROUND 0x80000000u // Set in the number of subcommands of a line ending in &
+#define SUBCOMMAND_WORDS 6 // Words before the args of a subcommand
+#define PROCESS_SUB_WORDS 3 // Words saved for each process substitution
+
+/**
+ * @brief The start of a cache file.
+ */
+struct rc_cache_header {
+  char magic[8]; ///< RC_CACHE_MAGIC
+  uint32_t version; ///< RC_CACHE_VERSION of the shell that wrote it
+  uint32_t path_size; ///< Bytes after the header holding the rc file's path, a multiple of 4
+  int64_t mtime_sec; ///< Modification time of the rc file
+  int64_t mtime_nsec;
+  int64_t size; ///< Size of the rc file
+  uint64_t num_words; ///< Words after the path
+  uint64_t strings_size; ///< Bytes of strings after the words
+};
+
+/**
+ * @brief Gets the name of the cache file for an rc file.
+ *
+ * @param rc_path The rc file
+ * @return char* The cache file's name, freed by the caller
+ */
+static char *cache_path(const char *rc_path) {
+  size_t size = strlen(rc_path) + sizeof(RC_CACHE_SUFFIX);
+  char *path = malloc(size);
+  snprintf(path, size, "%s%s", rc_path, RC_CACHE_SUFFIX);
+  return path;
+}
+
+/**
+ * @brief Gets the number of bytes the rc file's path takes up in the cache.
+ *
+ * @param rc_path The rc file
+ * @return size_t Length of the path with its null terminator, rounded up to a multiple of 4
+ */
+static size_t path_size(const char *rc_path) {
+  return (strlen(rc_path) + 1 + 3) & ~(size_t)3;
+}
+
+/**
+ * @brief Walks every line in a cache to check that it is whole and every string
+ * offset points inside the strings, so a damaged cache is never run.
+ *
+ * @param cache The cache being checked
+ * @param strings_size Bytes of strings
+ * @return int Returns 0 if every line is well formed, else -1
+ */
+static int check_words(struct rc_cache *cache, size_t strings_size) {
+  size_t i = 0;
+  while (i < cache->num_words) {
+    uint32_t num = cache->words[i++];
+    if (num == RC_CACHE_INVALID) {
+      continue;
+    }
+    num &= ~RC_CACHE_BACKGROUND;
+    for (uint32_t sub = 0; sub < num; sub++) {
+      if (cache->num_words - i < SUBCOMMAND_WORDS) {
+        return -1;
+      }
+      uint32_t argc = cache->words[i];
+      uint32_t num_subs = cache->words[i + 3];
+      size_t needed = SUBCOMMAND_WORDS + (size_t) argc + (size_t) num_subs * PROCESS_SUB_WORDS;
+      if (argc == 0 || num_subs > argc || cache->num_words - i < needed) {
+        return -1;
+      }
+      for (size_t word = i + 4; word < i + SUBCOMMAND_WORDS + argc; word++) {
+        if (cache->words[word] >= strings_size) {
+          return -1;
+        }
+      }
+      const uint32_t *process = cache->words + i + SUBCOMMAND_WORDS + argc;
+      for (uint32_t j = 0; j < num_subs; j++, process += PROCESS_SUB_WORDS) {
+        if (process[0] >= argc || process[2] >= strings_size) {
+          return -1;
+        }
+      }
+      i += needed;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Maps in the cache for an rc file, if there is one that was made from the rc
+ * file as it is now.
+ *
+ * @param cache Set up to read the cache
+ * @param rc_path The rc file
+ * @param rc_stat The rc file's stat
+ * @return int Returns 0 if the cache can be used, -1 if the rc file has to be parsed
+ */
+int rc_cache_open(struct rc_cache *cache, const char *rc_path, struct stat *rc_stat) {
+  char *path = cache_path(rc_path);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  free(path);
+  if (fd == -1) {
+    return -1;
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) == -1 || (size_t)sb.st_size < sizeof(struct rc_cache_header)) {
+    close(fd);
+    return -1;
+  }
+  cache->map_size = sb.st_size;
+  // Private and writable, nothing writes to the args but exec takes them as char *
+  cache->map = mmap(NULL, cache->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (cache->map == MAP_FAILED) {
+    return -1;
+  }
+
+  struct rc_cache_header *header = cache->map;
+  size_t rc_path_size = path_size(rc_path);
+  char *saved_path = (char *)(header + 1);
+  if (memcmp(header->magic, RC_CACHE_MAGIC, sizeof(header->magic)) != 0
+      || header->version != RC_CACHE_VERSION
+      || header->mtime_sec != rc_stat->st_mtim.tv_sec
+      || header->mtime_nsec != rc_stat->st_mtim.tv_nsec
+      || header->size != rc_stat->st_size
+      || header->path_size != rc_path_size
+      || header->num_words > cache->map_size / sizeof(uint32_t)
+      || header->strings_size > cache->map_size
+      || cache->map_size != sizeof(*header) + rc_path_size + header->num_words * sizeof(uint32_t) + header->strings_size
+      || strcmp(saved_path, rc_path) != 0) {
+    rc_cache_close(cache);
+    return -1;
+  }
+
+  cache->words = (const uint32_t *)(saved_path + rc_path_size);
+  cache->num_words = header->num_words;
+  cache->strings = (char *)(cache->words + cache->num_words);
+  cache->next = 0;
+  if ((header->strings_size > 0 && cache->strings[header->strings_size - 1] != '\0')
+      || check_words(cache, header->strings_size) == -1) {
+    rc_cache_close(cache);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Builds the list of subcommands for the next line in the cache. The args
+ * point into the cache, the arrays and structs come from the command line's arena.
+ *
+ * @param cache The cache being read
+ * @param cmdline Gets the number of subcommands, -1 for a line that did not parse
+ * @param list_commands The list the subcommands are added to
+ * @return int Returns 1 if a line was read, 0 once there are none left
+ */
+int rc_cache_next(struct rc_cache *cache, commandline *cmdline, struct list_head *list_commands) {
+  if (cache->next >= cache->num_words) {
+    return 0;
+  }
+
+  const uint32_t *word = cache->words + cache->next;
+  uint32_t num = *word++;
+  if (num == RC_CACHE_INVALID) {
+    cmdline->num = -1;
+    cache->next++;
+    return 1;
+  }
+  cmdline->background = (num & RC_CACHE_BACKGROUND) != 0;
+  num &= ~RC_CACHE_BACKGROUND;
+
+  for (uint32_t i = 0; i < num; i++) {
+    uint32_t argc = word[0];
+    struct subcommand *sub = arena_alloc(cmdline->arena, sizeof(struct subcommand));
+    memset(sub, 0, sizeof(struct subcommand)); // Not run yet
+    sub->type = word[1];
+    sub->input_type = word[2];
+    sub->num_subs = word[3];
+    sub->input = cache->strings + word[4];
+    sub->output = cache->strings + word[5];
+    sub->exec_args = arena_alloc(cmdline->arena, (argc + 1) * sizeof(char *));
+    for (uint32_t arg = 0; arg < argc; arg++) {
+      sub->exec_args[arg] = cache->strings + word[SUBCOMMAND_WORDS + arg];
+    }
+    sub->exec_args[argc] = NULL;
+    word += SUBCOMMAND_WORDS + argc;
+    if (sub->num_subs > 0) {
+      sub->subs = arena_alloc(cmdline->arena, sub->num_subs * sizeof(struct process_sub));
+      for (int j = 0; j < sub->num_subs; j++, word += PROCESS_SUB_WORDS) {
+        sub->subs[j].arg = word[0];
+        sub->subs[j].kind = word[1] == PROCESS_SUB_OUTPUT ? PROCESS_SUB_OUTPUT : PROCESS_SUB_INPUT;
+        sub->subs[j].command = cache->strings + word[2];
+        sub->subs[j].fd = -1;
+        sub->subs[j].pid = 0;
+      }
+    }
+    list_add_tail(&sub->list, list_commands);
+  }
+  cmdline->num = num;
+  cache->next = word - cache->words;
+  return 1;
+}
+
+/**
+ * @brief Unmaps a cache. Nothing read from it can be used afterwards.
+ *
+ * @param cache The cache
+ */
+void rc_cache_close(struct rc_cache *cache) {
+  munmap(cache->map, cache->map_size);
+  cache->map = NULL;
+}
+
+/**
+ * @brief Starts collecting parsed lines.
+ *
+ * @param writer The writer being set up
+ */
+void rc_cache_writer_init(struct rc_cache_writer *writer) {
+  memset(writer, 0, sizeof(*writer));
+}
+
+/**
+ * @brief Adds a word to the end of the words being collected.
+ *
+ * @param writer The writer
+ * @param word The word
+ */
+static void add_word(struct rc_cache_writer *writer, uint32_t word) {
+  if (writer->num_words == writer->words_size) {
+    writer->words_size = writer->words_size ? writer->words_size * 2 : 256;
+    writer->words = realloc(writer->words, writer->words_size * sizeof(uint32_t));
+  }
+  writer->words[writer->num_words++] = word;
+}
+
+/**
+ * @brief Adds a string to the strings being collected.
+ *
+ * @param writer The writer
+ * @param string The string
+ * @return uint32_t The offset of the string in the strings
+ */
+static uint32_t add_string(struct rc_cache_writer *writer, const char *string) {
+  size_t len = strlen(string) + 1;
+  while (writer->strings_used + len > writer->strings_size) {
+    writer->strings_size = writer->strings_size ? writer->strings_size * 2 : 4096;
+    writer->strings = realloc(writer->strings, writer->strings_size);
+  }
+  uint32_t offset = writer->strings_used;
+  memcpy(writer->strings + offset, string, len);
+  writer->strings_used += len;
+  return offset;
+}
+
+/**
+ * @brief Adds a parsed line to the cache being collected.
+ *
+ * @param writer The writer
+ * @param num The number of subcommands, -1 if the line did not parse
+ * @param background 1 if the line ended in &
+ * @param list_commands The subcommands parsed from the line
+ */
+void rc_cache_writer_add(struct rc_cache_writer *writer, int num, int background, struct list_head *list_commands) {
+  if (num == -1) {
+    add_word(writer, RC_CACHE_INVALID);
+    return;
+  } else if (num == 0) { // Blank lines are left out
+    return;
+  }
+
+  add_word(writer, background ? num | RC_CACHE_BACKGROUND : (uint32_t) num);
+  struct list_head *curr;
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    struct subcommand *sub = list_entry(curr, struct subcommand, list);
+    uint32_t argc = 0;
+    while (sub->exec_args[argc] != NULL) {
+      argc++;
+    }
+    add_word(writer, argc);
+    add_word(writer, sub->type);
+    add_word(writer, sub->input_type);
+    add_word(writer, sub->num_subs);
+    add_word(writer, add_string(writer, sub->input));
+    add_word(writer, add_string(writer, sub->output));
+    for (uint32_t arg = 0; arg < argc; arg++) {
+      add_word(writer, add_string(writer, sub->exec_args[arg]));
+    }
+    for (int j = 0; j < sub->num_subs; j++) {
+      add_word(writer, sub->subs[j].arg);
+      add_word(writer, sub->subs[j].kind);
+      add_word(writer, add_string(writer, sub->subs[j].command));
+    }
+  }
+}
+
+/**
+ * @brief Writes everything to a file all at once.
+ *
+ * @param fd The file
+ * @param data What is written
+ * @param size Bytes of data
+ * @return int Returns 0 if it was all written, else -1
+ */
+static int write_all(int fd, const void *data, size_t size) {
+  const char *bytes = data;
+  while (size > 0) {
+    ssize_t written = write(fd, bytes, size);
+    if (written <= 0) {
+      return -1;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return 0;
+}
+
+/**
+ * @brief Saves the collected lines as the cache for an rc file. The cache is written
+ * to a temporary file and renamed over the old one, so a shell starting at the same
+ * time never maps in half a cache. Failing to save is not an error, the rc file is
+ * just parsed again next time.
+ *
+ * @param writer The writer
+ * @param rc_path The rc file the lines were parsed from
+ * @param rc_stat The rc file's stat from before it was read
+ * @return int Returns 0 if the cache was saved, else -1
+ */
+int rc_cache_writer_save(struct rc_cache_writer *writer, const char *rc_path, struct stat *rc_stat) {
+  char *path = cache_path(rc_path);
+  size_t tmp_size = strlen(path) + sizeof(".XXXXXX");
+  char *tmp_path = malloc(tmp_size);
+  snprintf(tmp_path, tmp_size, "%s.XXXXXX", path);
+
+  int result = -1;
+  int fd = mkstemp(tmp_path);
+  if (fd == -1) {
+    goto cleanup;
+  }
+
+  struct rc_cache_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RC_CACHE_MAGIC, sizeof(header.magic));
+  header.version = RC_CACHE_VERSION;
+  header.path_size = path_size(rc_path);
+  header.mtime_sec = rc_stat->st_mtim.tv_sec;
+  header.mtime_nsec = rc_stat->st_mtim.tv_nsec;
+  header.size = rc_stat->st_size;
+  header.num_words = writer->num_words;
+  header.strings_size = writer->strings_used;
+
+  char *saved_path = calloc(1, header.path_size);
+  strcpy(saved_path, rc_path);
+  if (write_all(fd, &header, sizeof(header)) == 0
+      && write_all(fd, saved_path, header.path_size) == 0
+      && write_all(fd, writer->words, writer->num_words * sizeof(uint32_t)) == 0
+      && write_all(fd, writer->strings, writer->strings_used) == 0
+      && rename(tmp_path, path) == 0) {
+    result = 0;
+  } else {
+    unlink(tmp_path);
+  }
+  free(saved_path);
+  close(fd);
+
+cleanup:
+  free(tmp_path);
+  free(path);
+  return result;
+}
+
+/**
+ * @brief Frees the collected lines.
+ *
+ * @param writer The writer
+ */
+void rc_cache_writer_free(struct rc_cache_writer *writer) {
+  free(writer->words);
+  free(writer->strings);
+  rc_cache_writer_init(writer);
+}
@@ -0,0 +1,60 @@
+#ifndef RCCACHE_H
+#define RCCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "datastructures.h"
+
+#define RC_CACHE_VERSION 5 // Bumped whenever the file layout or the parser changes
+#define RC_CACHE_SUFFIX ".cache" // Added to the rc file's name to get the cache's
+
+/**
+ * @brief An rc cache that has been mapped in to be run. 
+ * 
+ * @param map The whole cache file
+ * @param map_size Bytes in map
+ * @param words The parsed lines, see rccache.c for the layout
+ * @param num_words Number of entries in words
+ * @param next The next entry in words to be read
+ * @param strings Every argument and file name, null terminated
+ */
+struct rc_cache {
+    void *map; 
+    size_t map_size; 
+    const uint32_t *words; 
+    size_t num_words; 
+    size_t next; 
+    char *strings; 
+}; 
+
+/**
+ * @brief The parsed lines of an rc file as they are being collected to be saved. 
+ * 
+ * @param words The parsed lines, see rccache.c for the layout
+ * @param num_words Number of entries in words
+ * @param words_size Number of entries words has room for
+ * @param strings Every argument and file name, null terminated
+ * @param strings_used Bytes of strings in use
+ * @param strings_size Bytes strings has room for
+ */
+struct rc_cache_writer {
+    uint32_t *words; 
+    size_t num_words; 
+    size_t words_size; 
+    char *strings; 
+    size_t strings_used; 
+    size_t strings_size; 
+}; 
+
+int rc_cache_open(struct rc_cache *cache, const char *rc_path, struct stat *rc_stat); 
+int rc_cache_next(struct rc_cache *cache, commandline *cmdline, struct list_head *list_commands); 
+void rc_cache_close(struct rc_cache *cache); 
+
+void rc_cache_writer_init(struct rc_cache_writer *writer); 
+void rc_cache_writer_add(struct rc_cache_writer *writer, int num, int background, struct list_head *list_commands); 
+int rc_cache_writer_save(struct rc_cache_writer *writer, const char *rc_path, struct stat *rc_stat); 
+void rc_cache_writer_free(struct rc_cache_writer *writer); 
+
+#endif
@@ -0,0 +1,511 @@
+/**
+ * @file resultcache.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief The cache prefix, which saves what a deterministic command line printed and
+ * its exit code, and replays them the next time the same line runs on the same input.
+ *
+ *   cache command args... [< file] [> file]
+ *   cache stats
+ *   cache purge
+ *
+ * A line is named by the SHA-256 of its args, redirects, the working directory, PATH,
+ * the variables listed in SUSH_CACHE_ENV, and the contents of every file or
+ * here-document it reads from with <. Each entry is a file named by that hash in
+ * SUSH_CACHE_DIR, $XDG_CACHE_HOME/sush or ~/.cache/sush. Using an entry touches it,
+ * and once the entries take more than SUSH_CACHE_SIZE bytes (256M by default) the
+ * least recently used are removed. Only stdout is saved. Files the command reads
+ * without a redirect are not part of the name, so they must not change. A line with
+ * an internal command other than echo, printf, true, false, test, [, copy, cat and pwd
+ * just runs, since it changes or reads the shell's variables, jobs or hash table.
+ * @version 0.1
+ * @date 2021-04-25
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#define _GNU_SOURCE // for asprintf and mkostemp
+#include <dirent.h> // for opendir
+#include <errno.h> // for errno
+#include <fcntl.h> // for open
+#include <stdio.h> // for fprintf
+#include <stdlib.h> // for memory allocation
+#include <string.h> // for string handling
+#include <unistd.h> // for dup2, pread and close
+#include <sys/stat.h> // for fstat and mkdir
+
+#include "resultcache.h"
+#include "sha256.h"
+#include "copyfd.h"
+#include "environ.h"
+#include "executor.h"
+#include "internal.h"
+#include "error.h"
+
+#define CACHE_MAGIC "SUSHRES1" // First bytes of every entry
+#define CACHE_HEADER_SIZE 12 // The magic, then the exit code
+#define CACHE_DEFAULT_SIZE (256LL << 20) // Bytes the entries may take without SUSH_CACHE_SIZE
+#define CACHE_MAX_STATUS 126 // Lines that could not run, or were killed, are not saved
+#define CACHE_READ_SIZE 65536 // Bytes read at a time when hashing an input file
+
+static int hits = 0; // Lines replayed by this shell
+static int misses = 0; // Lines run and saved by this shell
+
+/**
+ * @brief An entry of the store, as seen when deciding what to remove.
+ *
+ * @param name The file name, the hash in hex
+ * @param size Bytes the entry takes
+ * @param used When the entry was last saved or replayed
+ */
+struct cache_file {
+  char name[SHA256_SIZE * 2 + 1];
+  off_t size;
+  struct timespec used;
+};
+
+/**
+ * @brief Gets the directory entries are kept in, making it if it is not there.
+ *
+ * @param list_env List of environment variables
+ * @return char* The directory, freed by the caller, or NULL if there is nowhere to keep them
+ */
+static char *cache_dir(struct list_head *list_env) {
+  char *dir = get_env_value(list_env, "SUSH_CACHE_DIR");
+  char *path = NULL;
+  if (dir != NULL && *dir != '\0') {
+    path = strdup(dir);
+  } else if ((dir = get_env_value(list_env, "XDG_CACHE_HOME")) != NULL && *dir != '\0') {
+    if (asprintf(&path, "%s/sush", dir) == -1) {
+      return NULL;
+    }
+  } else if ((dir = get_env_value(list_env, "HOME")) != NULL && *dir != '\0') {
+    if (asprintf(&path, "%s/.cache/sush", dir) == -1) {
+      return NULL;
+    }
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    mkdir(path, 0700); // ~/.cache
+    *slash = '/';
+  } else {
+    return NULL;
+  }
+  if (mkdir(path, 0700) == -1 && errno != EEXIST) {
+    free(path);
+    return NULL;
+  }
+  return path;
+}
+
+/**
+ * @brief Gets how many bytes the entries may take, from SUSH_CACHE_SIZE, which is a
+ * number of bytes that may end in K, M or G.
+ *
+ * @param list_env List of environment variables
+ * @return long long The most bytes the entries may take
+ */
+static long long cache_limit(struct list_head *list_env) {
+  char *value = get_env_value(list_env, "SUSH_CACHE_SIZE");
+  if (value == NULL) {
+    return CACHE_DEFAULT_SIZE;
+  }
+  char *end;
+  long long limit = strtoll(value, &end, 10);
+  switch (*end) {
+    case 'G': limit <<= 10; // fall through
+    case 'M': limit <<= 10; // fall through
+    case 'K': limit <<= 10; end++; break;
+  }
+  return (*end != '\0' || end == value || limit < 0) ? CACHE_DEFAULT_SIZE : limit;
+}
+
+/**
+ * @brief Adds a string and its end to a hash, so "a" "bc" and "ab" "c" differ.
+ *
+ * @param hash The hash
+ * @param string The string
+ */
+static void hash_string(struct sha256 *hash, const char *string) {
+  sha256_update(hash, string, strlen(string) + 1);
+}
+
+/**
+ * @brief Adds the contents of a file to a hash.
+ *
+ * @param hash The hash
+ * @param path The file
+ * @return int 0 on success, -1 if it could not be read
+ */
+static int hash_file(struct sha256 *hash, const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return -1;
+  }
+  char *buf = malloc(CACHE_READ_SIZE);
+  ssize_t got;
+  while ((got = read(fd, buf, CACHE_READ_SIZE)) != 0) {
+    if (got == -1 && errno == EINTR) {
+      continue;
+    } else if (got == -1) {
+      break;
+    }
+    sha256_update(hash, buf, got);
+  }
+  free(buf);
+  close(fd);
+  return got == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Works out the name of a line's entry.
+ *
+ * @param list_commands The subcommands of the line, without cache
+ * @param list_env List of environment variables
+ * @param key Set to the name
+ * @return int 0 on success, -1 if the line can not be cached
+ */
+static int make_key(struct list_head *list_commands, struct list_head *list_env, char key[SHA256_SIZE * 2 + 1]) {
+  struct sha256 hash;
+  unsigned char digest[SHA256_SIZE];
+  char cwd[4096];
+  sha256_init(&hash);
+  hash_string(&hash, CACHE_MAGIC);
+  hash_string(&hash, getcwd(cwd, sizeof(cwd)) != NULL ? cwd : "");
+
+  // PATH picks which program runs, the rest are only there if asked for
+  char *path = get_env_value(list_env, "PATH");
+  hash_string(&hash, path != NULL ? path : "");
+  char *names = get_env_value(list_env, "SUSH_CACHE_ENV");
+  if (names != NULL) {
+    char *copy = strdup(names);
+    char *save;
+    for (char *name = strtok_r(copy, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+      char *value = get_env_value(list_env, name);
+      hash_string(&hash, name);
+      hash_string(&hash, value != NULL ? value : "");
+    }
+    free(copy);
+  }
+
+  struct list_head *curr;
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    struct subcommand *entry = list_entry(curr, struct subcommand, list);
+    if (entry->num_subs > 0) { // What a substitution gives is not known until it runs
+      return -1;
+    }
+    for (int i = 0; entry->exec_args[i] != NULL; i++) {
+      hash_string(&hash, entry->exec_args[i]);
+    }
+    uint32_t redirects[2] = { entry->input_type, entry->type };
+    sha256_update(&hash, redirects, sizeof(redirects));
+    hash_string(&hash, entry->input);
+    hash_string(&hash, entry->output);
+    if (entry->input_type == REDIRECT_INPUT && hash_file(&hash, entry->input) == -1) {
+      return -1;
+    }
+  }
+
+  sha256_final(&hash, digest);
+  for (int i = 0; i < SHA256_SIZE; i++) {
+    sprintf(key + i * 2, "%02x", digest[i]);
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks whether a line uses the shell's own state, which is not part of its
+ * entry's name, so replaying its output would be wrong. Only internal commands that
+ * print from their args, input and working directory alone are cached.
+ *
+ * @param list_commands The subcommands of the line
+ * @return int 1 if any stage is another internal command, else 0
+ */
+static int uses_shell_state(struct list_head *list_commands) {
+  static const char *cached[] = { "echo", "printf", "true", "false", "test", "[", "copy", "cat", "pwd", NULL };
+  struct list_head *curr;
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    struct subcommand *entry = list_entry(curr, struct subcommand, list);
+    if (internal_stage(entry->exec_args) == NOT_INTERNAL) {
+      continue;
+    }
+    int pure = 0;
+    for (int i = 0; cached[i] != NULL; i++) {
+      pure |= strcmp(entry->exec_args[0], cached[i]) == 0;
+    }
+    if (!pure) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Takes cache off the front of a parsed line and works out the line's entry.
+ * cache stats and cache purge are left for the cache internal command, and a line
+ * using the shell's state is run without the cache.
+ *
+ * @param cmdline The parsed line
+ * @param list_commands The subcommands of the line
+ * @param list_env List of environment variables
+ * @param key Set to the name of the line's entry
+ * @return int 1 if the line should be run through the cache, else 0
+ */
+int cache_prefix(commandline *cmdline, struct list_head *list_commands, struct list_head *list_env, char key[SHA256_SIZE * 2 + 1]) {
+  struct subcommand *first = list_entry(list_commands->next, struct subcommand, list);
+  if (cmdline->num == 0 || strcmp(first->exec_args[0], "cache") != 0 || first->exec_args[1] == NULL) {
+    return 0;
+  } else if (cmdline->num == 1 && first->exec_args[2] == NULL &&
+             (strcmp(first->exec_args[1], "stats") == 0 || strcmp(first->exec_args[1], "purge") == 0)) {
+    return 0;
+  }
+
+  first->exec_args++;
+  if (uses_shell_state(list_commands)) {
+    return 0;
+  }
+  return make_key(list_commands, list_env, key) == 0; // Else it just runs
+}
+
+/**
+ * @brief Opens where a line's output goes, the file its last stage redirects to or stdout.
+ *
+ * @param output The file, or "stdout"
+ * @param type How the file is opened
+ * @return int The file descriptor, or -1 if it could not be opened
+ */
+static int open_output(char *output, enum Token type) {
+  struct subcommand target = { .input_type = NORMAL, .output = output, .type = type };
+  int fds[2] = { STDIN_FILENO, STDOUT_FILENO };
+  return open_redirect_files(&target, fds) == -1 ? -1 : fds[1];
+}
+
+/**
+ * @brief Writes the output saved in an entry.
+ *
+ * @param fd The entry
+ * @param output The file the output goes to, or "stdout"
+ * @param type How the file is opened
+ */
+static void replay(int fd, char *output, enum Token type) {
+  struct stat sb;
+  int out = open_output(output, type);
+  if (out == -1) {
+    return;
+  }
+  fflush(stdout);
+  if (fstat(fd, &sb) == 0 && sb.st_size > CACHE_HEADER_SIZE) {
+    copy_range(fd, CACHE_HEADER_SIZE, sb.st_size - CACHE_HEADER_SIZE, out);
+  }
+  if (out != STDOUT_FILENO) {
+    close(out);
+  }
+}
+
+/**
+ * @brief Orders entries from least to most recently used, for qsort.
+ *
+ * @param a An entry
+ * @param b Another entry
+ * @return int Less than 0 if a was used first, more than 0 if b was, else 0
+ */
+static int compare_used(const void *a, const void *b) {
+  const struct timespec *x = &((const struct cache_file *)a)->used;
+  const struct timespec *y = &((const struct cache_file *)b)->used;
+  if (x->tv_sec != y->tv_sec) {
+    return x->tv_sec < y->tv_sec ? -1 : 1;
+  }
+  return x->tv_nsec < y->tv_nsec ? -1 : x->tv_nsec > y->tv_nsec;
+}
+
+/**
+ * @brief Lists the entries in the store.
+ *
+ * @param dir The store
+ * @param num_files Set to the number of entries
+ * @param total Set to the bytes they take
+ * @return struct cache_file* The entries, freed by the caller
+ */
+static struct cache_file *list_entries(const char *dir, int *num_files, long long *total) {
+  struct cache_file *files = NULL;
+  int capacity = 0;
+  *num_files = 0;
+  *total = 0;
+  DIR *stream = opendir(dir);
+  if (stream == NULL) {
+    return NULL;
+  }
+  struct dirent *dirent;
+  struct stat sb;
+  while ((dirent = readdir(stream)) != NULL) {
+    if (strlen(dirent->d_name) != SHA256_SIZE * 2 || strspn(dirent->d_name, "0123456789abcdef") != SHA256_SIZE * 2 ||
+        fstatat(dirfd(stream), dirent->d_name, &sb, AT_SYMLINK_NOFOLLOW) == -1 || !S_ISREG(sb.st_mode)) {
+      continue;
+    }
+    if (*num_files == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      files = realloc(files, capacity * sizeof(struct cache_file));
+    }
+    struct cache_file *file = &files[(*num_files)++];
+    strcpy(file->name, dirent->d_name);
+    file->size = sb.st_size;
+    file->used = sb.st_mtim;
+    *total += sb.st_size;
+  }
+  closedir(stream);
+  return files;
+}
+
+/**
+ * @brief Removes the least recently used entries until the rest fit in the limit.
+ *
+ * @param dir The store
+ * @param limit The most bytes the entries may take
+ */
+static void evict(const char *dir, long long limit) {
+  int num_files;
+  long long total;
+  struct cache_file *files = list_entries(dir, &num_files, &total);
+  if (total > limit) {
+    qsort(files, num_files, sizeof(struct cache_file), compare_used);
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    for (int i = 0; i < num_files && total > limit; i++) {
+      if (unlinkat(dir_fd, files[i].name, 0) == 0) {
+        total -= files[i].size;
+      }
+    }
+    close(dir_fd);
+  }
+  free(files);
+}
+
+/**
+ * @brief Runs the line with its output going to a new entry.
+ *
+ * @param fd The new entry, its header already written
+ * @param subcommand_count The number of subcommands in list_commands
+ * @param list_commands The subcommands of the line
+ * @param list_env List of environment variables
+ * @return int The exit code of the line
+ */
+static int run_into(int fd, int subcommand_count, struct list_head *list_commands, struct list_head *list_env) {
+  int status = 0;
+  fflush(stdout);
+  int saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+  if (saved == -1 || dup2(fd, STDOUT_FILENO) == -1) {
+    return 127;
+  }
+  int internal_code = handle_internal(list_commands, list_env, &status);
+  if (internal_code == 1) {
+    status = run_command(subcommand_count, list_commands, list_env);
+  } else if (internal_code == 6) { // exit is not a result to save
+    status = CACHE_MAX_STATUS;
+  }
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  return status;
+}
+
+/**
+ * @brief Runs a line that started with cache, see the top of this file.
+ *
+ * @param key The name of the line's entry, from cache_prefix
+ * @param subcommand_count The number of subcommands in list_commands
+ * @param list_commands The subcommands of the line, without cache
+ * @param list_env List of environment variables
+ * @return int The exit code of the line, saved or new
+ */
+int run_cached(char *key, int subcommand_count, struct list_head *list_commands, struct list_head *list_env) {
+  struct subcommand *last = list_entry(list_commands->prev, struct subcommand, list);
+  char *output = last->output; // The output is saved, then written where it was going
+  enum Token type = last->type;
+  char header[CACHE_HEADER_SIZE];
+  int32_t status;
+  char *dir = cache_dir(list_env);
+  char *path = NULL;
+  if (dir == NULL || asprintf(&path, "%s/%s", dir, key) == -1) {
+    free(dir);
+    return run_command(subcommand_count, list_commands, list_env);
+  }
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd != -1 && pread(fd, header, sizeof(header), 0) == sizeof(header) && memcmp(header, CACHE_MAGIC, 8) == 0) {
+    memcpy(&status, header + 8, sizeof(status));
+    futimens(fd, NULL); // Now the most recently used
+    replay(fd, output, type);
+    close(fd);
+    hits++;
+    free(path);
+    free(dir);
+    return status;
+  } else if (fd != -1) {
+    close(fd);
+  }
+
+  // Not saved yet, run it into a new entry that replaces the name once it is complete
+  char *temp = NULL;
+  if (asprintf(&temp, "%s/.new-XXXXXX", dir) == -1 || (fd = mkostemp(temp, O_CLOEXEC)) == -1) {
+    free(temp);
+    free(path);
+    free(dir);
+    return run_command(subcommand_count, list_commands, list_env);
+  }
+  last->output = "stdout";
+  memcpy(header, CACHE_MAGIC, 8);
+  memset(header + 8, 0, sizeof(status));
+  if (write(fd, header, sizeof(header)) != sizeof(header)) {
+    status = 127;
+  } else {
+    status = run_into(fd, subcommand_count, list_commands, list_env);
+  }
+  misses++;
+
+  memcpy(header + 8, &status, sizeof(status));
+  if (status >= 0 && status < CACHE_MAX_STATUS && pwrite(fd, header, sizeof(header), 0) == sizeof(header) &&
+      rename(temp, path) == 0) {
+    evict(dir, cache_limit(list_env));
+  } else {
+    unlink(temp);
+  }
+  replay(fd, output, type);
+  close(fd);
+  free(temp);
+  free(path);
+  free(dir);
+  return status;
+}
+
+/**
+ * @brief Handles the cache internal command. cache stats prints how much is saved and
+ * how often this shell used it, cache purge removes every entry.
+ *
+ * @param subcommand A parsed command from the commandline
+ * @param list_env List of environment variables
+ * @param io Where the command's output goes
+ * @return int If an error occured, output is -1 else output is 0
+ */
+int handle_cache(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  char *action = subcommand->exec_args[1];
+  if (action == NULL || subcommand->exec_args[2] != NULL ||
+      (strcmp(action, "stats") != 0 && strcmp(action, "purge") != 0)) {
+    fprintf(stderr, ERROR_CACHE_ARG);
+    return -1;
+  }
+  char *dir = cache_dir(list_env);
+  if (dir == NULL) {
+    fprintf(stderr, ERROR_CACHE_DIR);
+    return -1;
+  }
+
+  int num_files;
+  long long total;
+  if (strcmp(action, "stats") == 0) {
+    free(list_entries(dir, &num_files, &total));
+    fprintf(io->stream, MSG_CACHE_STATS, num_files, total, cache_limit(list_env), hits, misses, dir);
+  } else {
+    evict(dir, 0);
+  }
+  free(dir);
+  return 0;
+}
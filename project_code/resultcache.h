@@ -0,0 +1,13 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include "datastructures.h"
+#include "internal.h"
+#include "list.h"
+#include "sha256.h"
+
+int cache_prefix(commandline *cmdline, struct list_head *list_commands, struct list_head *list_env, char key[SHA256_SIZE * 2 + 1]); 
+int run_cached(char *key, int subcommand_count, struct list_head *list_commands, struct list_head *list_env); 
+int handle_cache(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+
+#endif
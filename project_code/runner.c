@@ -3,56 +3,54 @@
  * @author Isabella Boone 
  * @author John Gable
  * @author Hannah Moats
- * @brief Handle running user input and .sushrc file. 
+ * @brief Handle running user input, scripts and .sushrc file. 
  * @version 0.1
  * @date 2021-03-29
  * 
  * @copyright Copyright (c) 2021
  * 
  */
+#include <errno.h> // for errno
+#include <fcntl.h> // for open
 #include <stdio.h> // for i/o
 #include <stdlib.h> // for memory allocation
+#include <string.h> // for strerror
 #include <sys/stat.h> // for stat system call
+#include <unistd.h> // for isatty
 
 // Imports from our files
 #include "runner.h"
+#include "jobs.h"
+#include "linereader.h"
+#include "rccache.h"
+#include "timing.h"
+#include "trace.h"
+#include "heredoc.h"
+#include "background.h"
+#include "pipepart.h"
+#include "resultcache.h"
+#include "error.h"
+
+static int last_status = 0; // Exit code of the last command line that was run
 
 /**
- * @brief Clear a list of commands. 
+ * @brief Clear a list of commands. The subcommands belong to the command line's 
+ * arena and are freed with it. 
  * 
  * @param list list_head to be cleared. 
  */
 static void clear_list_command(struct list_head *list) {
-  struct subcommand *entry; 
-  while (!list_empty(list)) {
-    entry = list_entry(list->next, struct subcommand, list);
-    
-    // Free 2D array exec_args
-    int i = 0; // Count where we are in array
-    while (entry->exec_args[i] != NULL) {
-      free(entry->exec_args[i]); // Free array elements
-      i++; 
-    }
-    // Free entry and everything inside it
-    free(entry->exec_args);  
-    free(entry->input); 
-    free(entry->output); 
-    list_del(&entry->list); 
-    free(entry); 
-  }
+  INIT_LIST_HEAD(list); 
 }
 
 /**
- * @brief Free the commandline struct. 
+ * @brief Free the commandline struct. Everything parsed from the line was allocated 
+ * from the arena, so it is all handed back at once. 
  * 
  * @param cmdline commandline to be freed.
  */
 static void free_commandline_struct(commandline cmdline) {
-  // Free everything inside commandline
-  for(int i=0;i<cmdline.num; i++){
-    free(cmdline.subcommand[i]);
-  }
-  free(cmdline.subcommand); // Free commandline
+  arena_reset(cmdline.arena); 
 }
 
 /**
@@ -64,8 +62,9 @@ static void free_commandline_struct(commandline cmdline) {
  */
 static void freeing_on_exit(struct list_head *list_commands, struct list_head *list_env, commandline cmdline) {
   clear_list_command(list_commands); // Clear command
+  jobs_shutdown(); // Let queued jobs finish
   clear_list_env(list_env); // Clear environments
-  free_commandline_struct(cmdline); // Free commandline
+  arena_free(cmdline.arena); // Free commandline
 }
 
 
@@ -84,44 +83,81 @@ static int sushhome_exists(struct list_head *list_env){
 }
 
 /**
- * @brief Takes a command line and runs the command.
+ * @brief Runs a command line that has already been parsed into list_commands. A line 
+ * starting with time is run without it and what it cost is reported after. 
  * 
  * @param list_commands The list of comamnds, which is a list of subcommands
  * @param list_env The list_env that holds all the environment variables 
- * @param list_args The list of argumentst that are parsed from the command line
- * @param cmdline Struct which holds, unparsed subcommands, and the number of subcommands.
- * @param input The input buffer for fgets
+ * @param cmdline Struct which holds the line, and the number of subcommands.
+ * @param valid_cmdline -1 if the line did not parse, else 0
+ * @param tail 1 if nothing runs after this line, so a lone command can replace the shell
  */
-static void run_parser_executor_handler(struct list_head *list_commands, struct list_head *list_env, struct list_head *list_args, commandline cmdline, char *input) {
-
+static void run_parsed_commandline(struct list_head *list_commands, struct list_head *list_env, commandline cmdline, int valid_cmdline, int tail) {
+  struct line_timer timer; 
+  int timed = 0; 
+  int parted = 0; 
+  long copies; 
+  int cached = 0; 
+  char key[SHA256_SIZE * 2 + 1]; 
 
-  int len = strlen(input); 
-  
-  if(input[len-1]=='\n'){
-    input[len-1] = '\0';
+  if (valid_cmdline != -1 && !cmdline.background) {
+    timed = time_prefix(&cmdline, list_commands, &timer); 
+  }
+  if (valid_cmdline != -1 && timed != -1 && !cmdline.background) {
+    parted = pipepart_prefix(&cmdline, list_commands, &copies); 
+  }
+  if (valid_cmdline != -1 && timed != -1 && parted == 0 && !cmdline.background) {
+    cached = cache_prefix(&cmdline, list_commands, list_env, key); 
   }
-  
-  cmdline.num = find_num_subcommands(input, len);
-            
-  //creates an array of pointers, in proportion to the number of subcommands
-  cmdline.subcommand = malloc(cmdline.num *  sizeof(char *)); 
-  copy_subcommands(input, cmdline.num, cmdline.subcommand);
-  int valid_cmdline = parse_commandline(list_args, &cmdline, list_commands);
-
-  if (valid_cmdline == 0) { //If there were no errors when parsing 
-    //Checks if an internal command, if it is then it is run, else a normal command is run
-    int internal_code = handle_internal(list_commands, list_env);
-    if(internal_code == 1) { 
-      char **new_envp = make_env_array(list_env); 
-      run_command(cmdline.num, list_commands, new_envp);
-      clear_list_env(list_env); 
-      make_env_list(list_env, new_envp);
-      int list_env_len = getListLength(list_env); 
-      //free_env_array(new_envp, list_env_len);  
-    } else if (internal_code == 6) {  //if internal code was to exit
-      freeing_on_exit(list_commands, list_env, cmdline);
-      exit(0);
+  if (valid_cmdline == -1 || timed == -1 || parted == -1) {
+    last_status = 2; 
+  } else if (cmdline.background) { // The whole line runs in a copy of the shell, and is not waited for
+    pid_t pid = run_background(cmdline.num, list_commands, list_env); 
+    if (pid == -1) {
+      fprintf(stderr, ERROR_BACKGROUND, strerror(errno)); 
+      last_status = 1; 
+    } else {
+      fprintf(stderr, MSG_BACKGROUND, background_add(pid), pid); 
+      last_status = 0; 
     }
+  } else {
+    if (timed) {
+      time_start(&timer); 
+      last_status = 0; // Unless there is something to run
+    }
+    if (parted) {
+      last_status = run_pipepart(copies, cmdline.num, list_commands, list_env); 
+    } else if (cached) {
+      last_status = run_cached(key, cmdline.num, list_commands, list_env); 
+    } else if (cmdline.num > 0) { //If the line was not blank
+      //Checks if an internal command, if it is then it is run, else a normal command is run
+      int internal_code = handle_internal(list_commands, list_env, &last_status);
+      if(internal_code == 1) { 
+        fflush(stdout); // Output from internal commands must come before the child's
+        struct subcommand *first = list_entry(list_commands->next, struct subcommand, list); 
+        if (tail && !timed && cmdline.num == 1 && first->num_subs == 0 && !jobs_started() && internal_stage(first->exec_args) == NOT_INTERNAL) {
+          if (tracing()) {
+            trace_line(list_commands, cmdline.num, 0, 1); 
+          }
+          last_status = exec_command(list_commands, list_env); // Only returns on failure
+        } else {
+          last_status = run_command(cmdline.num, list_commands, list_env);
+        }
+      } else if (internal_code == 6) {  //if internal code was to exit
+        freeing_on_exit(list_commands, list_env, cmdline);
+        exit(0);
+      } else if (timed) {
+        time_shell_stage(&timer, list_commands, last_status); 
+      }
+    }
+    if (timed) {
+      fflush(stdout); // The report comes after the line's output
+      time_report(&timer, list_commands); 
+    }
+  }
+
+  if (tracing()) {
+    trace_line(list_commands, valid_cmdline == -1 ? -1 : cmdline.num, last_status, 0); 
   }
 
   //Free what we no longer need
@@ -129,6 +165,66 @@ static void run_parser_executor_handler(struct list_head *list_commands, struct
   clear_list_command(list_commands); 
 }
 
+/**
+ * @brief Takes a command line and runs the command.
+ * 
+ * @param list_commands The list of comamnds, which is a list of subcommands
+ * @param list_env The list_env that holds all the environment variables 
+ * @param cmdline Struct which holds the line, and the number of subcommands.
+ * @param input The line to run, without its newline
+ * @param reader Where the line came from, the bodies of its here-documents are read from it
+ * @param tail_exec 1 if the line's command may replace the shell when nothing runs after it
+ * @param writer If not NULL, the parsed line is added to it before it is run
+ */
+static void run_parser_executor_handler(struct list_head *list_commands, struct list_head *list_env, commandline cmdline, char *input, struct line_reader *reader, int tail_exec, struct rc_cache_writer *writer) {
+  if (strstr(input, "<<") != NULL) { // Reading a here-document's body can move the line
+    input = arena_strdup(cmdline.arena, input); 
+  }
+  cmdline.line = input; 
+  if (tracing()) {
+    trace_begin(TRACE_PARSE); 
+  }
+  int valid_cmdline = parse_commandline(&cmdline, list_commands);
+  if (valid_cmdline == 0 && read_heredocs(list_commands, reader, cmdline.arena) == -1) {
+    fprintf(stderr, ERROR_HEREDOC, strerror(errno)); 
+    INIT_LIST_HEAD(list_commands); 
+    valid_cmdline = -1; 
+  }
+  if (tracing()) {
+    trace_end(TRACE_PARSE); 
+  }
+  int tail = tail_exec && line_reader_at_end(reader); 
+  if (writer != NULL) {
+    rc_cache_writer_add(writer, valid_cmdline == -1 ? -1 : cmdline.num, cmdline.background, list_commands); 
+  }
+  run_parsed_commandline(list_commands, list_env, cmdline, valid_cmdline, tail); 
+}
+
+/**
+ * @brief Runs every line a reader gives, one after another. 
+ * 
+ * @param list_commands The list of comamnds, which is a list of subcommands
+ * @param list_env The list_env that holds all the environment variables 
+ * @param cmdline Struct which holds the line, and the number of subcommands.
+ * @param reader Where the lines come from
+ * @param interactive 1 if a prompt should be shown before each line
+ * @param tail_exec 1 if the last command may replace the shell instead of being forked
+ * @param writer If not NULL, every parsed line is added to it
+ */
+static void run_lines(struct list_head *list_commands, struct list_head *list_env, commandline cmdline, struct line_reader *reader, int interactive, int tail_exec, struct rc_cache_writer *writer) {
+  char *line; 
+
+  if (interactive) {
+    check_PS1(list_env); 
+  }
+  while ((line = line_reader_next(reader)) != NULL) {
+    run_parser_executor_handler(list_commands, list_env, cmdline, line, reader, tail_exec, writer);
+    if (interactive) {
+      check_PS1(list_env); 
+    }
+  }
+}
+
 /**
  * @brief Retrieves the sushrc files path from the SUSHHOME directory if it exists.
  * 
@@ -153,35 +249,61 @@ static char *getsushrc(struct list_head *list_env )
 }
 
 /**
- * @brief Checks to see if SUSHHOME environment variable was set, if so executes the .sushrc file
+ * @brief Runs every line saved in an rc cache. 
  * 
  * @param list_commands The list of comamnds, which is a list of subcommands
  * @param list_env The list_env that holds all the environment variables 
- * @param list_args The list of argumentst that are parsed from the command line
- * @param cmdline Struct which holds, unparsed subcommands, and the number of subcommands.
- * @param input The input buffer for fgets
+ * @param cmdline Struct which holds the line, and the number of subcommands.
+ * @param cache The cache the lines come from
  */
-void run_rc_file(struct list_head *list_commands, struct list_head *list_env, struct list_head *list_args, commandline cmdline, char *input) {
+static void run_cached_lines(struct list_head *list_commands, struct list_head *list_env, commandline cmdline, struct rc_cache *cache) {
+  while (rc_cache_next(cache, &cmdline, list_commands)) {
+    int valid_cmdline = 0; 
+    if (cmdline.num == -1) { // Report it the same way parsing it would
+      fprintf(stderr, ERROR_INVALID_CMDLINE); 
+      valid_cmdline = -1; 
+    }
+    run_parsed_commandline(list_commands, list_env, cmdline, valid_cmdline, 0); 
+  }
+}
+
+/**
+ * @brief Checks to see if SUSHHOME environment variable was set, if so executes the .sushrc file. 
+ * The parsed file is cached next to it, and the cache is run instead while the file is unchanged.
+ * 
+ * @param list_commands The list of comamnds, which is a list of subcommands
+ * @param list_env The list_env that holds all the environment variables 
+ * @param cmdline Struct which holds the line, and the number of subcommands.
+ */
+void run_rc_file(struct list_head *list_commands, struct list_head *list_env, commandline cmdline) {
   char *fname = NULL;
   if(sushhome_exists(list_env)){
     struct stat sb; //Keep track of information regarding the .sushrc file
     
     fname = getsushrc(list_env);
-    // printf("%s\n", fname);
     int stat_status = stat(fname, &sb);
-    if ((sb.st_mode & S_IRUSR) && (sb.st_mode & S_IXUSR)) { //if true file is valid, read from file
-      FILE *file = fopen(fname, "r");   //open .suhrc and read from it
+    if (stat_status == 0 && (sb.st_mode & S_IRUSR) && (sb.st_mode & S_IXUSR)) { //if true file is valid, read from file
+      struct rc_cache cache; 
+      if (rc_cache_open(&cache, fname, &sb) == 0) { // Already parsed, run what was saved
+        run_cached_lines(list_commands, list_env, cmdline, &cache); 
+        rc_cache_close(&cache); 
+      } else {
+        int fd = open(fname, O_RDONLY | O_CLOEXEC);   //open .suhrc and read from it
       
-      if (file == NULL) {
-        // printf("This file was null\n");
-        goto error;
+        if (fd == -1) {
+          goto error;
+        }
+        //read from file and execute commands, saving what was parsed for next time
+        struct line_reader reader; 
+        struct rc_cache_writer writer; 
+        line_reader_open_fd(&reader, fd); 
+        rc_cache_writer_init(&writer); 
+        run_lines(list_commands, list_env, cmdline, &reader, 0, 0, &writer); 
+        rc_cache_writer_save(&writer, fname, &sb); 
+        rc_cache_writer_free(&writer); 
+        line_reader_close(&reader); 
+        close(fd); 
       }
-      //read from file and execute commands 
-      while (fgets(input, INPUT_LENGTH-1, file)) {
-        // printf("contents: %s\n", input);
-        run_parser_executor_handler(list_commands, list_env, list_args, cmdline, input); 
-      } 
-      int flcose_status = fclose(file); 
     }
   } 
 
@@ -208,22 +330,62 @@ void check_PS1(struct list_head *list_env) {
 }
 
 /**
- * @brief Takes a command line from user input and runs it.
+ * @brief Takes command lines from standard input and runs them. The prompt is only 
+ * shown when standard input is a terminal, otherwise the input is run as a script. 
  * 
  * @param list_commands The list of comamnds, which is a list of subcommands
  * @param list_env The list_env that holds all the environment variables 
- * @param list_args The list of argumentst that are parsed from the command line
- * @param cmdline Struct which holds, unparsed subcommands, and the number of subcommands.
- * @param input The input buffer for fgets
+ * @param cmdline Struct which holds the line, and the number of subcommands.
+ * @return int The exit code of the last command run
  */
-void run_user_input(struct list_head *list_commands, struct list_head *list_env, struct list_head *list_args, commandline cmdline, char *input, int argc) {
+int run_user_input(struct list_head *list_commands, struct list_head *list_env, commandline cmdline) {
+  struct line_reader reader; 
+  int interactive = isatty(STDIN_FILENO); 
 
-  check_PS1(list_env); 
-  while(fgets(input, INPUT_LENGTH, stdin)) {
-    if(input[0] != '\n' && input[0]!=' '){
-      run_parser_executor_handler(list_commands, list_env, list_args, cmdline, input);
-    }
-    check_PS1(list_env);
+  line_reader_open_fd(&reader, STDIN_FILENO); 
+  run_lines(list_commands, list_env, cmdline, &reader, interactive, !interactive, NULL); 
+  line_reader_close(&reader); 
+  return last_status; 
+}
+
+/**
+ * @brief Runs a script file, as in sush script.sush. 
+ * 
+ * @param list_commands The list of comamnds, which is a list of subcommands
+ * @param list_env The list_env that holds all the environment variables 
+ * @param cmdline Struct which holds the line, and the number of subcommands.
+ * @param filename The script to run
+ * @return int The exit code of the last command run, 127 if the script could not be opened
+ */
+int run_script(struct list_head *list_commands, struct list_head *list_env, commandline cmdline, char *filename) {
+  struct line_reader reader; 
+  int fd = open(filename, O_RDONLY | O_CLOEXEC); 
+
+  if (fd == -1) {
+    fprintf(stderr, ERROR_SCRIPT_OPEN, filename, strerror(errno)); 
+    return 127; 
   }
+  line_reader_open_fd(&reader, fd); 
+  run_lines(list_commands, list_env, cmdline, &reader, 0, 1, NULL); 
+  line_reader_close(&reader); 
+  close(fd); 
+  return last_status; 
+}
+
+/**
+ * @brief Runs the lines in a string, as in sush -c 'command'. 
+ * 
+ * @param list_commands The list of comamnds, which is a list of subcommands
+ * @param list_env The list_env that holds all the environment variables 
+ * @param cmdline Struct which holds the line, and the number of subcommands.
+ * @param string The lines to run
+ * @return int The exit code of the last command run
+ */
+int run_string(struct list_head *list_commands, struct list_head *list_env, commandline cmdline, char *string) {
+  struct line_reader reader; 
 
-}
\ No newline at end of file
+  line_reader_open_string(&reader, string); 
+  run_lines(list_commands, list_env, cmdline, &reader, 0, 1, NULL); 
+  line_reader_close(&reader); 
+  return last_status; 
+}
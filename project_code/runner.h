@@ -7,9 +7,10 @@
 #include "internal.h" 
 #include "environ.h"
 
-#define INPUT_LENGTH 4094 // Max input length for strings
-
-void run_rc_file(struct list_head *list_commands, struct list_head *list_env, struct list_head *list_args, commandline cmdline, char *input);
-void run_user_input(struct list_head *list_commands, struct list_head *list_env, struct list_head *list_args, commandline cmdline, char *input, int argc); 
+void check_PS1(struct list_head *list_env); 
+void run_rc_file(struct list_head *list_commands, struct list_head *list_env, commandline cmdline);
+int run_user_input(struct list_head *list_commands, struct list_head *list_env, commandline cmdline); 
+int run_script(struct list_head *list_commands, struct list_head *list_env, commandline cmdline, char *filename); 
+int run_string(struct list_head *list_commands, struct list_head *list_env, commandline cmdline, char *string); 
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_SIZE 32 // Bytes in a digest
+
+/**
+ * @brief A SHA-256 digest being computed. 
+ * 
+ * @param state The hash so far
+ * @param length Bytes hashed so far
+ * @param block Bytes waiting for a full block
+ * @param used Bytes in block
+ */
+struct sha256 {
+    uint32_t state[8]; 
+    uint64_t length; 
+    unsigned char block[64]; 
+    size_t used; 
+}; 
+
+void sha256_init(struct sha256 *hash); 
+void sha256_update(struct sha256 *hash, const void *data, size_t size); 
+void sha256_final(struct sha256 *hash, unsigned char digest[SHA256_SIZE]); 
+
+#endif
@@ -9,32 +9,73 @@
  */
 
 // Imports
+#include <errno.h> // for errno
 #include <stdio.h> // for I/O
 #include <stdlib.h> // for memory allocation
+#include <string.h> // for strcmp
 
 // Imports from our files
 #include "runner.h"
-
-#define INPUT_LENGTH 4094 // Max input length for strings
+#include "jobs.h"
+#include "error.h"
+#include "trace.h"
+#include "worker.h"
+#include "pathcache.h"
 
 /**
  * @brief Project 2: Shell Project 
  * 
- * @return int 
+ * sush reads commands from standard input, sush script runs a script file and 
+ * sush -c 'command' runs the given command lines. sush --worker socket runs jobs 
+ * sent to the socket by other shells. 
+ * 
+ * @return int The exit code of the last command run
  */
 int main(int argc, char **argv, char **envp) {
-  commandline cmdline;
-  LIST_HEAD(list_args); 
+  struct arena arena = ARENA_INIT; // Owns everything parsed from one command line
+  commandline cmdline = { .arena = &arena };
   LIST_HEAD(list_commands); // a list of subcommand structs, represents the comamndline
   LIST_HEAD(list_env); // List of environment variables
 
-  char input[INPUT_LENGTH]; 
+  int status; // Exit code of the last command run
+
+  if (argc > 1 && (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "--worker") == 0) && argc != 3) {
+    fprintf(stderr, ERROR_USAGE); 
+    return 2; 
+  }
   make_env_list(&list_env, envp); //creates a linked list of environment variables
+  path_cache_init(); // Before jobs_init, a fork takes job_lock and then cache_lock
+  jobs_init(); 
+
+  //SUSH_LAUNCHER=fork starts commands with fork instead of posix_spawn
+  char *launcher = get_env_value(&list_env, "SUSH_LAUNCHER"); 
+  if (launcher != NULL && strcmp(launcher, "fork") == 0) {
+    set_launcher(LAUNCH_FORK); 
+  }
+
+  //SUSH_TRACE=path appends a JSON record of every command line to path
+  char *trace_path = get_env_value(&list_env, "SUSH_TRACE"); 
+  if (trace_path != NULL && trace_open(trace_path) == -1) {
+    fprintf(stderr, ERROR_TRACE_OPEN, trace_path, strerror(errno)); 
+  }
+
+  if (argc > 1 && strcmp(argv[1], "--worker") == 0) { // Jobs bring their own environment
+    return run_worker(argv[2]); 
+  }
 
-  run_rc_file(&list_commands, &list_env, &list_args,  cmdline, input);
+  run_rc_file(&list_commands, &list_env, cmdline);
 
-  //scan for user input
-  run_user_input(&list_commands, &list_env, &list_args, cmdline, input, argc); 
+  if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+    status = run_string(&list_commands, &list_env, cmdline, argv[2]); 
+  } else if (argc > 1) {
+    status = run_script(&list_commands, &list_env, cmdline, argv[1]); 
+  } else {
+    //scan for user input
+    status = run_user_input(&list_commands, &list_env, cmdline); 
+  }
+  jobs_shutdown(); // Let queued jobs finish
   clear_list_env(&list_env); 
+  arena_free(&arena); 
+  return status; 
 }
 
@@ -5,6 +5,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
 
 #include "environ.h"
 #include "datastructures.h"
@@ -135,8 +136,149 @@ void test_print_list(struct list_head *list_commands) {
 
 }
 
-/*
-//Commented out to compile sush without main yelling
+#ifdef SUSH_TEST // sush is built from every .c file, so the checks and main are only built by make test
+static int failures = 0; // Checks that did not get the output they expected
+
+/**
+ * @brief Runs lines in a new ./sush and collects what they print to stdout. 
+ * 
+ * @param script The lines, separated by newlines
+ * @param output Filled with what was printed, NUL terminated
+ * @param size Bytes output has room for
+ */
+void run_sush(const char *script, char *output, size_t size) {
+    int fds[2]; 
+    size_t used = 0; 
+    output[0] = '\0'; 
+    if (pipe(fds) == -1) {
+        return; 
+    }
+
+    pid_t pid = fork(); 
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO); 
+        close(fds[0]); 
+        close(fds[1]); 
+        freopen("/dev/null", "w", stderr); // Errors are not part of the output checked
+        execl("./sush", "sush", "-c", script, (char *)NULL); 
+        exit(127); 
+    }
+    close(fds[1]); 
+    ssize_t got; 
+    while (used + 1 < size && (got = read(fds[0], output + used, size - used - 1)) > 0) {
+        used += got; 
+    }
+    output[used] = '\0'; 
+    close(fds[0]); 
+    waitpid(pid, NULL, 0); 
+}
+
+/**
+ * @brief Checks that lines run in ./sush print exactly what is expected. 
+ * 
+ * @param name What is being checked
+ * @param script The lines
+ * @param expected The output they should print
+ */
+void check_output(const char *name, const char *script, const char *expected) {
+    char output[4096]; 
+    run_sush(script, output, sizeof(output)); 
+    if (strcmp(output, expected) == 0) {
+        printf("PASS %s\n", name); 
+    } else {
+        printf("FAIL %s\nexpected:\n%sgot:\n%s", name, expected, output); 
+        failures++; 
+    }
+}
+
+/**
+ * @brief Checks that lines run in ./sush print something containing what is expected. 
+ * 
+ * @param name What is being checked
+ * @param script The lines
+ * @param expected Text the output should contain
+ */
+void check_contains(const char *name, const char *script, const char *expected) {
+    char output[4096]; 
+    run_sush(script, output, sizeof(output)); 
+    if (strstr(output, expected) != NULL) {
+        printf("PASS %s\n", name); 
+    } else {
+        printf("FAIL %s\nexpected to contain:\n%s\ngot:\n%s", name, expected, output); 
+        failures++; 
+    }
+}
+
+/**
+ * @brief Writes a file in the test directory. 
+ * 
+ * @param path Where the file goes
+ * @param contents What it holds
+ * @param mode Its permissions
+ */
+void write_file(const char *path, const char *contents, mode_t mode) {
+    FILE *file = fopen(path, "w"); 
+    fputs(contents, file); 
+    fclose(file); 
+    chmod(path, mode); 
+}
+
+/**
+ * @brief Test that the cache prefix replays a line, names it by its input, and never 
+ * caches lines that read the shell's variables or jobs 
+ * 
+ * @param dir A scratch directory, used as SUSH_CACHE_DIR
+ */
+void test_cache(const char *dir) {
+    char script[1024]; 
+    char input[512]; 
+    char late[512]; 
+    snprintf(input, sizeof(input), "%s/input", dir); 
+    snprintf(late, sizeof(late), "%s/late", dir); 
+    write_file(late, "#!/bin/sh\nsleep 0.3\necho late\n", 0755); 
+
+    check_output("cache replays the output", "cache echo hi\ncache echo hi", "hi\nhi\n"); 
+    check_contains("cache counts the replay as a hit", "cache echo counted\ncache echo counted\ncache stats", "1 hits and 1 misses"); 
+
+    snprintf(script, sizeof(script), "cache cat < %s", input); 
+    write_file(input, "one\n", 0644); 
+    check_output("cache reads a new input file", script, "one\n"); 
+    write_file(input, "two\n", 0644); 
+    check_output("cache does not replay a changed input file", script, "two\n"); 
+
+    check_output("cache does not replay getenv", 
+        "setenv FOO one\ncache getenv FOO\nsetenv FOO two\ncache getenv FOO", "FOO=one\nFOO=two\n"); 
+    check_output("cache does not replay status", 
+        "queue true\nsleep 0.3\ncache status\nqueue true\nsleep 0.3\ncache status", 
+        "0 is queued\n0 is complete\n1 is queued\n0 is complete\n1 is complete\n"); 
+    snprintf(script, sizeof(script), "queue %s\ncache output 0\nsleep 0.6\ncache output 0", late); 
+    check_output("cache does not replay output of a running task", script, "0 is queued\nlate\n"); 
+}
+
+/**
+ * @brief Test that parallel keeps the input order with -k and prints as commands 
+ * finish without it, with inputs from ::: or from the input 
+ * 
+ * @param dir A scratch directory
+ */
+void test_parallel(const char *dir) {
+    char script[1024]; 
+    char delay[512]; 
+    char inputs[512]; 
+    snprintf(delay, sizeof(delay), "%s/delay", dir); 
+    snprintf(inputs, sizeof(inputs), "%s/inputs", dir); 
+    write_file(delay, "#!/bin/sh\nsleep 0.$1\necho $1\n", 0755); // Inputs that finish out of order
+    write_file(inputs, "7\n1\n4\n", 0644); 
+
+    snprintf(script, sizeof(script), "parallel -k -j 3 %s ::: 7 1 4", delay); 
+    check_output("parallel -k keeps the input order", script, "7\n1\n4\n"); 
+    snprintf(script, sizeof(script), "parallel -j 3 %s ::: 7 1 4", delay); 
+    check_output("parallel prints as commands finish", script, "1\n4\n7\n"); 
+    snprintf(script, sizeof(script), "parallel -k -j3 %s < %s", delay, inputs); 
+    check_output("parallel -k keeps the order of inputs read from the input", script, "7\n1\n4\n"); 
+    check_output("parallel takes -j with the count attached", "parallel -k -j2 echo ::: a b c", "a\nb\nc\n"); 
+}
+
 int main (int argc, char **argv, char **envp) {
 
     
@@ -162,7 +304,6 @@ int main (int argc, char **argv, char **envp) {
 
     printf("\nTest next to last: \n"); 
     test_free_env_array(envp_test, &list_envp); 
-    printf("Freed??? %s\n", envp_test[0]); //yay it works
     
 
     printf("\nTest last: \n"); 
@@ -209,7 +350,26 @@ int main (int argc, char **argv, char **envp) {
 
     set_env(&list_envp, "PS1", ">"); 
     display_env_list(&list_envp); 
-    
-    return 0; 
-} */
+
+    char dir[] = "/tmp/sush-test-XXXXXX"; 
+    if (mkdtemp(dir) == NULL) {
+        perror("Could not make test directory"); 
+        return 1; 
+    }
+    setenv("SUSH_CACHE_DIR", dir, 1); 
+
+    printf("\nTest cache: \n"); 
+    test_cache(dir); 
+
+    printf("\nTest parallel: \n"); 
+    test_parallel(dir); 
+
+    char remove[64]; 
+    snprintf(remove, sizeof(remove), "rm -rf %s", dir); 
+    system(remove); 
+
+    printf("\n%d checks failed\n", failures); 
+    return failures == 0 ? 0 : 1; 
+}
+#endif
 
@@ -0,0 +1,155 @@
+/**
+ * @file timing.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief The time prefix. time runs the rest of the command line and reports what 
+ * every stage cost: wall clock time, user and system CPU time, max RSS, context 
+ * switches and page faults. Forked stages are measured with wait4, stages run in a 
+ * shell thread measure themselves, see run_command. time -m prints key=value pairs 
+ * for scripts to read. 
+ * @version 0.1
+ * @date 2021-04-20
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <stdio.h> // for fprintf
+#include <string.h> // for strcmp
+#include <sys/time.h> // for timersub
+
+#include "timing.h"
+#include "error.h"
+
+/**
+ * @brief Seconds from one time to another. 
+ * 
+ * @param start The earlier time
+ * @param end The later time
+ * @return double The seconds between them
+ */
+static double seconds_between(const struct timespec *start, const struct timespec *end) {
+  return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9; 
+}
+
+/**
+ * @brief Converts a CPU time from an rusage to seconds. 
+ * 
+ * @param time The CPU time
+ * @return double The time in seconds
+ */
+static double timeval_seconds(const struct timeval *time) {
+  return time->tv_sec + time->tv_usec / 1e6; 
+}
+
+/**
+ * @brief Subtracts one rusage's CPU times and counters from another's. The max RSS 
+ * is a high water mark, so the later one is kept. 
+ * 
+ * @param after Set to what was used between before and after
+ * @param before The earlier reading
+ */
+void rusage_since(struct rusage *after, const struct rusage *before) {
+  timersub(&after->ru_utime, &before->ru_utime, &after->ru_utime); 
+  timersub(&after->ru_stime, &before->ru_stime, &after->ru_stime); 
+  after->ru_minflt -= before->ru_minflt; 
+  after->ru_majflt -= before->ru_majflt; 
+  after->ru_nvcsw -= before->ru_nvcsw; 
+  after->ru_nivcsw -= before->ru_nivcsw; 
+}
+
+/**
+ * @brief Checks for time at the start of a command line and takes it off, along 
+ * with its -m option, so the rest of the line runs as if it was typed alone. 
+ * 
+ * @param cmdline The parsed command line
+ * @param list_commands The subcommands of the line
+ * @param timer Set up for timing the line if it starts with time
+ * @return int 1 if the line is timed, 0 if not, -1 if time has nothing to run in a pipeline
+ */
+int time_prefix(commandline *cmdline, struct list_head *list_commands, struct line_timer *timer) {
+  struct subcommand *first = list_entry(list_commands->next, struct subcommand, list); 
+  if (cmdline->num == 0 || strcmp(first->exec_args[0], "time") != 0) {
+    return 0; 
+  }
+
+  timer->format = TIME_HUMAN; 
+  first->exec_args++; 
+  if (first->exec_args[0] != NULL && strcmp(first->exec_args[0], "-m") == 0) {
+    timer->format = TIME_MACHINE; 
+    first->exec_args++; 
+  }
+
+  if (first->exec_args[0] == NULL) {
+    if (cmdline->num > 1) { 
+      fprintf(stderr, ERROR_INVALID_CMDLINE); 
+      return -1; 
+    }
+    list_del(&first->list); // time alone times nothing
+    cmdline->num = 0; 
+  }
+  return 1; 
+}
+
+/**
+ * @brief Marks when a timed line starts. 
+ * 
+ * @param timer The line's timer
+ */
+void time_start(struct line_timer *timer) {
+  clock_gettime(CLOCK_MONOTONIC, &timer->start); 
+  getrusage(RUSAGE_SELF, &timer->self); 
+}
+
+/**
+ * @brief Fills in what a lone internal command cost when the shell itself ran it, 
+ * which is everything the shell used since the line started. 
+ * 
+ * @param timer The line's timer
+ * @param list_commands The subcommands of the line, there is only one
+ * @param status The exit code of the command
+ */
+void time_shell_stage(struct line_timer *timer, struct list_head *list_commands, int status) {
+  struct subcommand *entry = list_entry(list_commands->next, struct subcommand, list); 
+  entry->status = status; 
+
+  entry->usage.start = timer->start; 
+  clock_gettime(CLOCK_MONOTONIC, &entry->usage.end); 
+  getrusage(RUSAGE_SELF, &entry->usage.rusage); 
+  rusage_since(&entry->usage.rusage, &timer->self); 
+}
+
+/**
+ * @brief Prints what every stage of a timed line cost, then the line as a whole, 
+ * to stderr so it does not mix with the line's output. 
+ * 
+ * @param timer The line's timer
+ * @param list_commands The subcommands of the line
+ */
+void time_report(struct line_timer *timer, struct list_head *list_commands) {
+  struct list_head *curr; 
+  struct timespec end; 
+  double user = 0, sys = 0; 
+  long maxrss = 0; 
+  int stage = 1; 
+
+  clock_gettime(CLOCK_MONOTONIC, &end); 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next, stage++) {
+    struct subcommand *entry = list_entry(curr, struct subcommand, list); 
+    struct rusage *usage = &entry->usage.rusage; 
+    double real = seconds_between(&entry->usage.start, &entry->usage.end); 
+    double stage_user = timeval_seconds(&usage->ru_utime); 
+    double stage_sys = timeval_seconds(&usage->ru_stime); 
+
+    fprintf(stderr, timer->format == TIME_MACHINE ? MSG_TIME_STAGE_KEYS : MSG_TIME_STAGE, 
+            stage, entry->exec_args[0], real, stage_user, stage_sys, usage->ru_maxrss, 
+            usage->ru_nvcsw, usage->ru_nivcsw, usage->ru_minflt, usage->ru_majflt, entry->status); 
+    user += stage_user; 
+    sys += stage_sys; 
+    if (usage->ru_maxrss > maxrss) {
+      maxrss = usage->ru_maxrss; 
+    }
+  }
+  fprintf(stderr, timer->format == TIME_MACHINE ? MSG_TIME_TOTAL_KEYS : MSG_TIME_TOTAL, 
+          seconds_between(&timer->start, &end), user, sys, maxrss); 
+}
@@ -0,0 +1,37 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include "datastructures.h"
+#include "list.h"
+
+/**
+ * @brief How the report of a timed command line is printed. 
+ */
+enum Time_Format {
+  TIME_HUMAN, 
+  TIME_MACHINE // key=value pairs, one line per stage
+}; 
+
+/**
+ * @brief A command line being timed. 
+ * 
+ * @param format How the report is printed
+ * @param start When the line started, from CLOCK_MONOTONIC
+ * @param self Resources the shell had used when the line started
+ */
+struct line_timer {
+  enum Time_Format format; 
+  struct timespec start; 
+  struct rusage self; 
+}; 
+
+void rusage_since(struct rusage *after, const struct rusage *before); 
+int time_prefix(commandline *cmdline, struct list_head *list_commands, struct line_timer *timer); 
+void time_start(struct line_timer *timer); 
+void time_shell_stage(struct line_timer *timer, struct list_head *list_commands, int status); 
+void time_report(struct line_timer *timer, struct list_head *list_commands); 
+
+#endif
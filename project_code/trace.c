@@ -0,0 +1,202 @@
+/**
+ * @file trace.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Execution tracing. When SUSH_TRACE names a file, a JSON object is appended 
+ * to it for every command line run, with CLOCK_MONOTONIC timestamps in nanoseconds 
+ * for parsing, building the environment, launching and waiting, the number of 
+ * environment entries copied, and the args, pid, exit code and times of each stage. 
+ * Every record is written with one write to a file opened with O_APPEND, so shells 
+ * sharing a trace file do not mix their lines. 
+ * @version 0.1
+ * @date 2021-04-20
+ * 
+ * @copyright Copyright (c) 2021
+ * 
+ */
+#include <errno.h> // for EINTR
+#include <fcntl.h> // for open
+#include <stdio.h> // for open_memstream
+#include <stdlib.h> // for free
+#include <string.h> // for memset
+#include <time.h> // for clock_gettime
+#include <unistd.h> // for write and getpid
+
+#include "trace.h"
+
+int trace_fd = -1; // The trace file, -1 when tracing is off
+
+/**
+ * @brief The timestamps of the command line being run. 
+ * 
+ * @param start When each phase started, 0 if it did not happen
+ * @param end When each phase ended
+ * @param env_copied Environment entries copied into the array for exec, 0 if it was reused
+ */
+static struct {
+  long long start[TRACE_PHASES]; 
+  long long end[TRACE_PHASES]; 
+  int env_copied; 
+} record; 
+
+static const char *phase_names[TRACE_PHASES] = { "parse", "env", "launch", "wait" }; 
+
+/**
+ * @brief Reads the monotonic clock. 
+ * 
+ * @return long long Nanoseconds since some point in the past
+ */
+static long long now_ns(void) {
+  struct timespec now; 
+  clock_gettime(CLOCK_MONOTONIC, &now); 
+  return now.tv_sec * 1000000000LL + now.tv_nsec; 
+}
+
+/**
+ * @brief Converts a timestamp recorded by the executor to nanoseconds. 
+ * 
+ * @param time The timestamp
+ * @return long long The same time in nanoseconds
+ */
+static long long timespec_ns(const struct timespec *time) {
+  return time->tv_sec * 1000000000LL + time->tv_nsec; 
+}
+
+/**
+ * @brief Starts tracing every command line to a file. 
+ * 
+ * @param path The file records are appended to
+ * @return int 0 on success, -1 if the file could not be opened
+ */
+int trace_open(const char *path) {
+  trace_fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644); 
+  return trace_fd == -1 ? -1 : 0; 
+}
+
+/**
+ * @brief Marks the start of a phase of the current command line. 
+ * 
+ * @param phase The phase
+ */
+void trace_begin(enum Trace_Phase phase) {
+  record.start[phase] = now_ns(); 
+}
+
+/**
+ * @brief Marks the end of a phase of the current command line. 
+ * 
+ * @param phase The phase
+ */
+void trace_end(enum Trace_Phase phase) {
+  record.end[phase] = now_ns(); 
+}
+
+/**
+ * @brief Records how many environment entries were copied for exec. 
+ * 
+ * @param count The number of entries
+ */
+void trace_env_copied(int count) {
+  record.env_copied = count; 
+}
+
+/**
+ * @brief Writes a string as a JSON string, escaping what JSON needs escaped. 
+ * 
+ * @param stream Where it is written
+ * @param string The string
+ */
+static void write_json_string(FILE *stream, const char *string) {
+  fputc('"', stream); 
+  for (const unsigned char *c = (const unsigned char *) string; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(stream, "\\%c", *c); 
+    } else if (*c < 0x20) {
+      fprintf(stream, "\\u%04x", *c); 
+    } else {
+      fputc(*c, stream); 
+    }
+  }
+  fputc('"', stream); 
+}
+
+/**
+ * @brief Writes the stages of the command line as a JSON array. 
+ * 
+ * @param stream Where it is written
+ * @param list_commands The subcommands of the line
+ */
+static void write_stages(FILE *stream, struct list_head *list_commands) {
+  struct list_head *curr; 
+
+  fputs("\"stages\":[", stream); 
+  for (curr = list_commands->next; curr != list_commands; curr = curr->next) {
+    struct subcommand *entry = list_entry(curr, struct subcommand, list); 
+    fputs("{\"argv\":[", stream); 
+    for (int i = 0; entry->exec_args[i] != NULL; i++) {
+      if (i > 0) {
+        fputc(',', stream); 
+      }
+      write_json_string(stream, entry->exec_args[i]); 
+    }
+    fprintf(stream, "],\"pid\":%d,\"status\":%d", (int) entry->pid, entry->status); 
+    if (entry->usage.start.tv_sec != 0 || entry->usage.start.tv_nsec != 0) { // Run by the executor
+      fprintf(stream, ",\"start\":%lld,\"launched\":%lld,\"end\":%lld", 
+              timespec_ns(&entry->usage.start), timespec_ns(&entry->usage.launched), 
+              timespec_ns(&entry->usage.end)); 
+    }
+    fputs(curr->next == list_commands ? "}" : "},", stream); 
+  }
+  fputc(']', stream); 
+}
+
+/**
+ * @brief Appends the record of a command line to the trace file and starts a new one. 
+ * 
+ * @param list_commands The subcommands of the line
+ * @param num The number of subcommands, 0 for a blank line, -1 if it did not parse
+ * @param status The exit code of the line
+ * @param tail_exec 1 if the shell is about to be replaced by the line's command
+ */
+void trace_line(struct list_head *list_commands, int num, int status, int tail_exec) {
+  char *buf = NULL; 
+  size_t size = 0; 
+  FILE *stream = open_memstream(&buf, &size); 
+  if (stream == NULL) {
+    return; 
+  }
+
+  fprintf(stream, "{\"shell\":%d,\"end\":%lld,\"subcommands\":%d", (int) getpid(), now_ns(), num); 
+  for (int i = 0; i < TRACE_PHASES; i++) {
+    if (record.start[i] != 0) {
+      fprintf(stream, ",\"%s\":[%lld,%lld]", phase_names[i], record.start[i], record.end[i]); 
+    }
+  }
+  if (record.start[TRACE_ENV] != 0) {
+    fprintf(stream, ",\"env_copied\":%d", record.env_copied); 
+  }
+  if (tail_exec) {
+    fputs(",\"exec\":true", stream); // The shell becomes the command, there is no status
+  } else {
+    fprintf(stream, ",\"status\":%d", status); 
+  }
+  if (num > 0) {
+    fputc(',', stream); 
+    write_stages(stream, list_commands); 
+  }
+  fputs("}\n", stream); 
+  fclose(stream); 
+
+  for (size_t done = 0; done < size; ) {
+    ssize_t written = write(trace_fd, buf + done, size - done); 
+    if (written == -1 && errno == EINTR) {
+      continue; 
+    } else if (written <= 0) {
+      break; 
+    }
+    done += written; 
+  }
+  free(buf); 
+  memset(&record, 0, sizeof(record)); 
+}
@@ -0,0 +1,35 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "datastructures.h"
+#include "list.h"
+
+/**
+ * @brief The steps of running a command line that are timed by the trace. 
+ */
+enum Trace_Phase {
+  TRACE_PARSE, // Splitting the line into subcommands
+  TRACE_ENV, // Building the environment array handed to exec
+  TRACE_LAUNCH, // Starting every stage, fork and exec
+  TRACE_WAIT, // Waiting for every stage to finish
+  TRACE_PHASES
+}; 
+
+extern int trace_fd; 
+
+/**
+ * @brief Checks if command lines are being traced, cheap enough to call anywhere. 
+ * 
+ * @return int 1 if SUSH_TRACE was set, else 0
+ */
+static inline int tracing(void) {
+  return trace_fd != -1; 
+}
+
+int trace_open(const char *path); 
+void trace_begin(enum Trace_Phase phase); 
+void trace_end(enum Trace_Phase phase); 
+void trace_env_copied(int count); 
+void trace_line(struct list_head *list_commands, int num, int status, int tail_exec); 
+
+#endif
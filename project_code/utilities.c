@@ -0,0 +1,882 @@
+/**
+ * @file utilities.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Builtin versions of small utilities scripts run all the time: echo, printf,
+ * true, false, test (also called as [) and copy (also called as cat). They behave like the POSIX utilities, so
+ * a script gets the same output whether the builtin or the program on PATH runs, and
+ * they save a fork and exec every time they are used. Running one by its path, as in
+ * /bin/echo, still runs the program.
+ * @version 0.1
+ * @date 2021-04-18
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#include <ctype.h> // for isdigit
+#include <errno.h> // for errno
+#include <fcntl.h> // for open
+#include <inttypes.h> // for strtoimax
+#include <stdio.h> // for printf
+#include <stdlib.h> // for strtold
+#include <string.h> // for strcmp
+#include <sys/stat.h> // for stat
+#include <unistd.h> // for access and isatty
+
+#include "utilities.h"
+#include "copyfd.h"
+#include "error.h"
+
+#define TEST_TRUE 0 // Exit code of test when the expression is true
+#define TEST_FALSE 1 // Exit code of test when the expression is false
+#define TEST_ERROR 2 // Exit code of test when the expression is malformed
+
+#define SPEC_LENGTH 64 // Longest printf conversion specification that is copied
+
+/**
+ * @brief Counts the arguments in a subcommand, not counting the NULL at the end.
+ *
+ * @param subcommand The subcommand
+ * @return int The number of args
+ */
+static int count_args(struct subcommand *subcommand) {
+  int count = 0;
+  while (subcommand->exec_args[count] != NULL) {
+    count++;
+  }
+  return count;
+}
+
+/**
+ * @brief Gets the value of an octal digit.
+ *
+ * @param c The character
+ * @return int The value, or -1 if it is not an octal digit
+ */
+static int octal_value(char c) {
+  return (c >= '0' && c <= '7') ? c - '0' : -1;
+}
+
+/**
+ * @brief Gets the value of a hex digit.
+ *
+ * @param c The character
+ * @return int The value, or -1 if it is not a hex digit
+ */
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/**
+ * @brief Prints the character a backslash escape stands for. echo -e and printf's
+ * %b write octal as \0NNN, a printf format writes it as \NNN.
+ *
+ * @param stream Where the character is printed
+ * @param escape The characters after the backslash
+ * @param zero_octal 1 if octal escapes start with \0, as in echo -e and %b
+ * @param stop Set to 1 for \c, which ends all output
+ * @return int The number of characters after the backslash that were used
+ */
+static int print_escape(FILE *stream, const char *escape, int zero_octal, int *stop) {
+  int used = 1;
+  int value;
+
+  switch (escape[0]) {
+    case 'a': putc('\a', stream); break;
+    case 'b': putc('\b', stream); break;
+    case 'e': putc('\033', stream); break;
+    case 'f': putc('\f', stream); break;
+    case 'n': putc('\n', stream); break;
+    case 'r': putc('\r', stream); break;
+    case 't': putc('\t', stream); break;
+    case 'v': putc('\v', stream); break;
+    case '\\': putc('\\', stream); break;
+    case 'c': *stop = 1; break;
+    case 'x':
+      if (hex_value(escape[1]) == -1) { // Not an escape after all
+        putc('\\', stream);
+        putc('x', stream);
+        break;
+      }
+      value = 0;
+      while (used < 3 && hex_value(escape[used]) != -1) {
+        value = value * 16 + hex_value(escape[used++]);
+      }
+      putc(value, stream);
+      break;
+    default:
+      if (octal_value(escape[0]) != -1 && (!zero_octal || escape[0] == '0')) {
+        int start = zero_octal ? 1 : 0; // The leading 0 is not one of the digits
+        value = 0;
+        used = start;
+        while (used < start + 3 && octal_value(escape[used]) != -1) {
+          value = value * 8 + octal_value(escape[used++]);
+        }
+        putc(value & 0xff, stream);
+      } else if (escape[0] == '\0') { // Backslash at the end of the string
+        putc('\\', stream);
+        used = 0;
+      } else { // Unknown escapes are printed as they are
+        putc('\\', stream);
+        putc(escape[0], stream);
+      }
+      break;
+  }
+  return used;
+}
+
+/**
+ * @brief Prints a string, turning backslash escapes into the characters they stand for.
+ *
+ * @param stream Where the string is printed
+ * @param str The string
+ * @param zero_octal 1 if octal escapes start with \0
+ * @return int 1 if a \c was found and nothing more should be printed, else 0
+ */
+static int print_escaped(FILE *stream, const char *str, int zero_octal) {
+  int stop = 0;
+  while (*str != '\0' && !stop) {
+    if (*str == '\\') {
+      str++;
+      str += print_escape(stream, str, zero_octal, &stop);
+    } else {
+      putc(*str++, stream);
+    }
+  }
+  return stop;
+}
+
+/**
+ * @brief Checks whether an echo argument is a group of options, like -n or -neE.
+ *
+ * @param arg The argument
+ * @return int 1 if every character after the dash is n, e or E, else 0
+ */
+static int is_echo_option(const char *arg) {
+  if (arg[0] != '-' || arg[1] == '\0') {
+    return 0;
+  }
+  for (int i = 1; arg[i] != '\0'; i++) {
+    if (arg[i] != 'n' && arg[i] != 'e' && arg[i] != 'E') {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief The echo builtin. Prints its arguments separated by spaces and followed by
+ * a newline. -n leaves out the newline, -e turns on backslash escapes and -E turns
+ * them back off, the same as GNU echo.
+ *
+ * @param subcommand A parsed command from the commandline
+ * @param list_env Not used
+ * @param io Where the output goes
+ * @return int Always 0
+ */
+int handle_echo(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  char **args = subcommand->exec_args + 1;
+  int newline = 1;
+  int escapes = 0;
+
+  while (*args != NULL && is_echo_option(*args)) {
+    for (char *opt = *args + 1; *opt != '\0'; opt++) {
+      if (*opt == 'n') {
+        newline = 0;
+      } else if (*opt == 'e') {
+        escapes = 1;
+      } else {
+        escapes = 0;
+      }
+    }
+    args++;
+  }
+
+  for (int i = 0; args[i] != NULL; i++) {
+    if (i > 0) {
+      putc(' ', io->stream);
+    }
+    if (escapes) {
+      if (print_escaped(io->stream, args[i], 1)) {
+        return 0; // \c ends the output, newline included
+      }
+    } else {
+      fputs(args[i], io->stream);
+    }
+  }
+  if (newline) {
+    putc('\n', io->stream);
+  }
+  return 0;
+}
+
+/**
+ * @brief The true builtin.
+ *
+ * @param subcommand Not used
+ * @param list_env Not used
+ * @param io Not used
+ * @return int Always 0
+ */
+int handle_true(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  return 0;
+}
+
+/**
+ * @brief The false builtin.
+ *
+ * @param subcommand Not used
+ * @param list_env Not used
+ * @param io Not used
+ * @return int Always 1
+ */
+int handle_false(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  return 1;
+}
+
+/**
+ * @brief The arguments left for printf's conversions.
+ *
+ * @param args The arguments after the format
+ * @param count Number of args
+ * @param used Number of args converted so far
+ * @param status Exit code of printf, set to 1 when an argument is not a number
+ * @param stream Where printf writes its output
+ */
+struct printf_args {
+  char **args;
+  int count;
+  int used;
+  int status;
+  FILE *stream;
+};
+
+/**
+ * @brief Gets the next argument for a conversion.
+ *
+ * @param pargs The arguments
+ * @return char* The argument, or NULL once they have all been used
+ */
+static char *next_arg(struct printf_args *pargs) {
+  if (pargs->used < pargs->count) {
+    return pargs->args[pargs->used++];
+  }
+  return NULL;
+}
+
+/**
+ * @brief Checks that a number was read from the whole argument, and reports it if not.
+ *
+ * @param pargs The arguments, status is set on an error
+ * @param arg The argument
+ * @param end Where reading the number stopped
+ */
+static void check_number(struct printf_args *pargs, const char *arg, const char *end) {
+  if (errno == ERANGE) {
+    fprintf(stderr, ERROR_PRINTF_RANGE, arg);
+    pargs->status = 1;
+  } else if (end == arg || *end != '\0') {
+    fprintf(stderr, ERROR_PRINTF_NUMBER, arg);
+    pargs->status = 1;
+  }
+}
+
+/**
+ * @brief Gets the next argument as a signed integer. An argument starting with a
+ * quote is the value of the character after it.
+ *
+ * @param pargs The arguments
+ * @return intmax_t The value, 0 if there are no arguments left
+ */
+static intmax_t next_int(struct printf_args *pargs) {
+  char *arg = next_arg(pargs);
+  if (arg == NULL) {
+    return 0;
+  } else if (arg[0] == '"' || arg[0] == '\'') {
+    return (unsigned char)arg[1];
+  }
+  char *end;
+  errno = 0;
+  intmax_t value = strtoimax(arg, &end, 0);
+  check_number(pargs, arg, end);
+  return value;
+}
+
+/**
+ * @brief Gets the next argument as an unsigned integer, negative values wrap around.
+ *
+ * @param pargs The arguments
+ * @return uintmax_t The value, 0 if there are no arguments left
+ */
+static uintmax_t next_uint(struct printf_args *pargs) {
+  char *arg = next_arg(pargs);
+  if (arg == NULL) {
+    return 0;
+  } else if (arg[0] == '"' || arg[0] == '\'') {
+    return (unsigned char)arg[1];
+  }
+  char *end;
+  errno = 0;
+  uintmax_t value = strtoumax(arg, &end, 0);
+  check_number(pargs, arg, end);
+  return value;
+}
+
+/**
+ * @brief Gets the next argument as a floating point number.
+ *
+ * @param pargs The arguments
+ * @return long double The value, 0 if there are no arguments left
+ */
+static long double next_float(struct printf_args *pargs) {
+  char *arg = next_arg(pargs);
+  if (arg == NULL) {
+    return 0;
+  } else if (arg[0] == '"' || arg[0] == '\'') {
+    return (unsigned char)arg[1];
+  }
+  char *end;
+  errno = 0;
+  long double value = strtold(arg, &end);
+  check_number(pargs, arg, end);
+  return value;
+}
+
+/**
+ * @brief Prints one conversion. The specification is copied with the * width and
+ * precision filled in and a length modifier added, then handed to printf.
+ *
+ * @param spec The conversion from the format, starting at the %
+ * @param pargs The arguments
+ * @param stop Set to 1 if %b found a \c
+ * @return int The number of characters of spec used, or -1 if it is not a valid conversion
+ */
+static int print_conversion(const char *spec, struct printf_args *pargs, int *stop) {
+  char copy[SPEC_LENGTH];
+  int len = 0;
+  int i = 1;
+
+  copy[len++] = '%';
+  while (strchr("-+ #0", spec[i]) != NULL && spec[i] != '\0' && len < SPEC_LENGTH - 32) { // Flags
+    copy[len++] = spec[i++];
+  }
+  if (spec[i] == '*') { // Width from the arguments
+    len += snprintf(copy + len, SPEC_LENGTH - len, "%d", (int)next_int(pargs));
+    i++;
+  } else {
+    while (isdigit((unsigned char)spec[i]) && len < SPEC_LENGTH - 24) {
+      copy[len++] = spec[i++];
+    }
+  }
+  if (spec[i] == '.') { // Precision
+    copy[len++] = spec[i++];
+    if (spec[i] == '*') {
+      len += snprintf(copy + len, SPEC_LENGTH - len, "%d", (int)next_int(pargs));
+      i++;
+    } else {
+      while (isdigit((unsigned char)spec[i]) && len < SPEC_LENGTH - 16) {
+        copy[len++] = spec[i++];
+      }
+    }
+  }
+
+  char conversion = spec[i];
+  if (conversion == '\0' || strchr("diouxXeEfFgGaAcsb", conversion) == NULL) {
+    return -1;
+  }
+  i++;
+
+  if (strchr("di", conversion) != NULL) {
+    copy[len++] = 'j';
+    copy[len++] = conversion;
+    copy[len] = '\0';
+    fprintf(pargs->stream, copy, next_int(pargs));
+  } else if (strchr("ouxX", conversion) != NULL) {
+    copy[len++] = 'j';
+    copy[len++] = conversion;
+    copy[len] = '\0';
+    fprintf(pargs->stream, copy, next_uint(pargs));
+  } else if (strchr("eEfFgGaA", conversion) != NULL) {
+    copy[len++] = 'L';
+    copy[len++] = conversion;
+    copy[len] = '\0';
+    fprintf(pargs->stream, copy, next_float(pargs));
+  } else if (conversion == 'c') {
+    char *arg = next_arg(pargs);
+    copy[len++] = 'c';
+    copy[len] = '\0';
+    if (arg != NULL && arg[0] != '\0') {
+      fprintf(pargs->stream, copy, arg[0]);
+    }
+  } else if (conversion == 's') {
+    char *arg = next_arg(pargs);
+    copy[len++] = 's';
+    copy[len] = '\0';
+    fprintf(pargs->stream, copy, arg != NULL ? arg : "");
+  } else { // %b, the argument with escapes
+    char *arg = next_arg(pargs);
+    if (arg != NULL) {
+      *stop = print_escaped(pargs->stream, arg, 1);
+    }
+  }
+  return i;
+}
+
+/**
+ * @brief Prints the format once, using up arguments for its conversions.
+ *
+ * @param format The format
+ * @param pargs The arguments
+ * @return int 1 if printing should stop (a \c, or a bad conversion), else 0
+ */
+static int print_format(const char *format, struct printf_args *pargs) {
+  int stop = 0;
+  while (*format != '\0' && !stop) {
+    if (*format == '\\') {
+      format++;
+      format += print_escape(pargs->stream, format, 0, &stop);
+    } else if (*format == '%' && format[1] == '%') {
+      putc('%', pargs->stream);
+      format += 2;
+    } else if (*format == '%') {
+      int used = print_conversion(format, pargs, &stop);
+      if (used == -1) {
+        fprintf(stderr, ERROR_PRINTF_CONVERSION, format);
+        pargs->status = 1;
+        return 1;
+      }
+      format += used;
+    } else {
+      putc(*format++, pargs->stream);
+    }
+  }
+  return stop;
+}
+
+/**
+ * @brief The printf builtin. Prints the arguments the way the format says, and like
+ * the POSIX utility the format is used again until every argument has been used.
+ *
+ * @param subcommand A parsed command from the commandline
+ * @param list_env Not used
+ * @param io Where the output goes
+ * @return int 0, or 1 if the format was bad or an argument was not a number
+ */
+int handle_printf(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = count_args(subcommand);
+  if (num_args < 2) {
+    fprintf(stderr, ERROR_PRINTF_ARG);
+    return 1;
+  }
+
+  struct printf_args pargs = { subcommand->exec_args + 2, num_args - 2, 0, 0, io->stream };
+  char *format = subcommand->exec_args[1];
+  int used_before;
+  do {
+    used_before = pargs.used;
+    if (print_format(format, &pargs)) {
+      break;
+    }
+  } while (pargs.used < pargs.count && pargs.used > used_before);
+  return pargs.status;
+}
+
+/**
+ * @brief The expression test is working through.
+ *
+ * @param args The arguments making up the expression
+ * @param count Number of args
+ * @param pos The next argument to be read
+ * @param error Set once the expression is found to be malformed
+ */
+struct test_expr {
+  char **args;
+  int count;
+  int pos;
+  int error;
+};
+
+/**
+ * @brief Reports a malformed expression.
+ *
+ * @param expr The expression
+ * @param message What is wrong
+ * @param arg The argument at fault
+ * @return int Always 0, so it can be returned as the value of a test
+ */
+static int test_error(struct test_expr *expr, const char *message, const char *arg) {
+  if (!expr->error) {
+    fprintf(stderr, ERROR_TEST, message, arg);
+  }
+  expr->error = 1;
+  return 0;
+}
+
+/**
+ * @brief Reads an integer operand of test.
+ *
+ * @param expr The expression
+ * @param arg The operand
+ * @return long long The value
+ */
+static long long test_integer(struct test_expr *expr, const char *arg) {
+  char *end;
+  errno = 0;
+  long long value = strtoll(arg, &end, 10);
+  while (isspace((unsigned char)*end)) {
+    end++;
+  }
+  if (end == arg || *end != '\0' || errno == ERANGE) {
+    test_error(expr, "integer expression expected", arg);
+  }
+  return value;
+}
+
+/**
+ * @brief Checks whether an argument is one of test's binary operators.
+ *
+ * @param op The argument
+ * @return int 1 if it is a binary operator, else 0
+ */
+static int is_binary_op(const char *op) {
+  const char *ops[] = { "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+                        "-nt", "-ot", "-ef", NULL };
+  for (int i = 0; ops[i] != NULL; i++) {
+    if (strcmp(op, ops[i]) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks whether an argument is one of test's unary operators.
+ *
+ * @param op The argument
+ * @return int 1 if it is a unary operator, else 0
+ */
+static int is_unary_op(const char *op) {
+  return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("bcdefghkLnprsStuwxzOG", op[1]) != NULL;
+}
+
+/**
+ * @brief Evaluates a binary operator.
+ *
+ * @param expr The expression
+ * @param left The left operand
+ * @param op The operator
+ * @param right The right operand
+ * @return int 1 if true, else 0
+ */
+static int test_binary(struct test_expr *expr, const char *left, const char *op, const char *right) {
+  struct stat left_sb, right_sb;
+
+  if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) {
+    return strcmp(left, right) == 0;
+  } else if (strcmp(op, "!=") == 0) {
+    return strcmp(left, right) != 0;
+  } else if (strcmp(op, "<") == 0) {
+    return strcmp(left, right) < 0;
+  } else if (strcmp(op, ">") == 0) {
+    return strcmp(left, right) > 0;
+  } else if (strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0) {
+    int left_ok = stat(left, &left_sb) == 0;
+    int right_ok = stat(right, &right_sb) == 0;
+    if (strcmp(op, "-ef") == 0) {
+      return left_ok && right_ok && left_sb.st_dev == right_sb.st_dev && left_sb.st_ino == right_sb.st_ino;
+    }
+    if (!left_ok || !right_ok) { // A missing file is older than any file
+      return strcmp(op, "-nt") == 0 ? left_ok : right_ok;
+    }
+    long long diff = left_sb.st_mtim.tv_sec != right_sb.st_mtim.tv_sec
+                     ? (long long)left_sb.st_mtim.tv_sec - right_sb.st_mtim.tv_sec
+                     : (long long)left_sb.st_mtim.tv_nsec - right_sb.st_mtim.tv_nsec;
+    return strcmp(op, "-nt") == 0 ? diff > 0 : diff < 0;
+  }
+
+  long long a = test_integer(expr, left);
+  long long b = test_integer(expr, right);
+  if (strcmp(op, "-eq") == 0) {
+    return a == b;
+  } else if (strcmp(op, "-ne") == 0) {
+    return a != b;
+  } else if (strcmp(op, "-lt") == 0) {
+    return a < b;
+  } else if (strcmp(op, "-le") == 0) {
+    return a <= b;
+  } else if (strcmp(op, "-gt") == 0) {
+    return a > b;
+  }
+  return a >= b; // -ge
+}
+
+/**
+ * @brief Evaluates a unary operator.
+ *
+ * @param expr The expression
+ * @param op The operator
+ * @param arg The operand
+ * @return int 1 if true, else 0
+ */
+static int test_unary(struct test_expr *expr, const char *op, const char *arg) {
+  struct stat sb;
+
+  switch (op[1]) {
+    case 'n': return arg[0] != '\0';
+    case 'z': return arg[0] == '\0';
+    case 't': return isatty((int)test_integer(expr, arg));
+    case 'r': return access(arg, R_OK) == 0;
+    case 'w': return access(arg, W_OK) == 0;
+    case 'x': return access(arg, X_OK) == 0;
+    case 'h':
+    case 'L': return lstat(arg, &sb) == 0 && S_ISLNK(sb.st_mode);
+  }
+
+  if (stat(arg, &sb) != 0) {
+    return 0;
+  }
+  switch (op[1]) {
+    case 'b': return S_ISBLK(sb.st_mode);
+    case 'c': return S_ISCHR(sb.st_mode);
+    case 'd': return S_ISDIR(sb.st_mode);
+    case 'e': return 1;
+    case 'f': return S_ISREG(sb.st_mode);
+    case 'g': return (sb.st_mode & S_ISGID) != 0;
+    case 'k': return (sb.st_mode & S_ISVTX) != 0;
+    case 'p': return S_ISFIFO(sb.st_mode);
+    case 's': return sb.st_size > 0;
+    case 'S': return S_ISSOCK(sb.st_mode);
+    case 'u': return (sb.st_mode & S_ISUID) != 0;
+    case 'O': return sb.st_uid == geteuid();
+    case 'G': return sb.st_gid == getegid();
+  }
+  return 0;
+}
+
+static int test_or(struct test_expr *expr);
+
+/**
+ * @brief Evaluates a primary: a parenthesised expression, a binary or unary test,
+ * or a lone string, which is true when it is not empty.
+ *
+ * @param expr The expression
+ * @return int 1 if true, else 0
+ */
+static int test_primary(struct test_expr *expr) {
+  int left = expr->count - expr->pos;
+  char **args = expr->args + expr->pos;
+
+  if (left <= 0) {
+    return test_error(expr, "argument expected", expr->count > 0 ? expr->args[expr->count - 1] : "");
+  }
+  if (left >= 3 && is_binary_op(args[1])) {
+    expr->pos += 3;
+    return test_binary(expr, args[0], args[1], args[2]);
+  }
+  if (strcmp(args[0], "(") == 0) {
+    expr->pos++;
+    int value = test_or(expr);
+    if (expr->pos >= expr->count || strcmp(expr->args[expr->pos], ")") != 0) {
+      return test_error(expr, "')' expected", expr->pos < expr->count ? expr->args[expr->pos] : "");
+    }
+    expr->pos++;
+    return value;
+  }
+  if (left >= 2 && is_unary_op(args[0])) {
+    expr->pos += 2;
+    return test_unary(expr, args[0], args[1]);
+  }
+  expr->pos++;
+  return args[0][0] != '\0';
+}
+
+/**
+ * @brief Evaluates ! expression, or a primary.
+ *
+ * @param expr The expression
+ * @return int 1 if true, else 0
+ */
+static int test_not(struct test_expr *expr) {
+  if (expr->pos < expr->count && strcmp(expr->args[expr->pos], "!") == 0 && expr->count - expr->pos > 1) {
+    expr->pos++;
+    return !test_not(expr);
+  }
+  return test_primary(expr);
+}
+
+/**
+ * @brief Evaluates expressions joined by -a.
+ *
+ * @param expr The expression
+ * @return int 1 if true, else 0
+ */
+static int test_and(struct test_expr *expr) {
+  int value = test_not(expr);
+  while (expr->pos < expr->count && strcmp(expr->args[expr->pos], "-a") == 0) {
+    expr->pos++;
+    value = test_not(expr) && value;
+  }
+  return value;
+}
+
+/**
+ * @brief Evaluates expressions joined by -o.
+ *
+ * @param expr The expression
+ * @return int 1 if true, else 0
+ */
+static int test_or(struct test_expr *expr) {
+  int value = test_and(expr);
+  while (expr->pos < expr->count && strcmp(expr->args[expr->pos], "-o") == 0) {
+    expr->pos++;
+    value = test_and(expr) || value;
+  }
+  return value;
+}
+
+/**
+ * @brief Evaluates a whole test expression. Expressions of up to four arguments
+ * follow the POSIX rules, which decide by the number of arguments, longer ones are
+ * parsed with ! binding tightest, then -a, then -o.
+ *
+ * @param expr The expression
+ * @return int 1 if true, else 0
+ */
+static int test_eval(struct test_expr *expr) {
+  char **args = expr->args;
+
+  switch (expr->count) {
+    case 0:
+      return 0;
+    case 1:
+      expr->pos = 1;
+      return args[0][0] != '\0';
+    case 2:
+      if (strcmp(args[0], "!") == 0) {
+        expr->pos = 2;
+        return args[1][0] == '\0';
+      } else if (is_unary_op(args[0])) {
+        expr->pos = 2;
+        return test_unary(expr, args[0], args[1]);
+      }
+      return test_error(expr, "unary operator expected", args[0]);
+    case 3:
+      if (is_binary_op(args[1])) {
+        expr->pos = 3;
+        return test_binary(expr, args[0], args[1], args[2]);
+      } else if (strcmp(args[0], "!") == 0) {
+        expr->args++;
+        expr->count--;
+        int value = !test_eval(expr);
+        expr->args--;
+        expr->count++;
+        expr->pos++;
+        return value;
+      } else if (strcmp(args[0], "(") == 0 && strcmp(args[2], ")") == 0) {
+        expr->pos = 3;
+        return args[1][0] != '\0';
+      }
+      break;
+    case 4:
+      if (strcmp(args[0], "!") == 0) {
+        expr->args++;
+        expr->count--;
+        int value = !test_eval(expr);
+        expr->args--;
+        expr->count++;
+        expr->pos++;
+        return value;
+      } else if (strcmp(args[0], "(") == 0 && strcmp(args[3], ")") == 0) {
+        expr->args++;
+        expr->count -= 2;
+        int value = test_eval(expr);
+        expr->args--;
+        expr->count += 2;
+        expr->pos += 2;
+        return value;
+      }
+      break;
+  }
+  return test_or(expr);
+}
+
+/**
+ * @brief The test builtin, also run as [, which needs a ] as its last argument.
+ *
+ * @param subcommand A parsed command from the commandline
+ * @param list_env Not used
+ * @param io Not used
+ * @return int 0 if the expression is true, 1 if it is false, 2 if it is malformed
+ */
+int handle_test(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = count_args(subcommand);
+  struct test_expr expr = { subcommand->exec_args + 1, num_args - 1, 0, 0 };
+
+  if (strcmp(subcommand->exec_args[0], "[") == 0) {
+    if (num_args < 2 || strcmp(subcommand->exec_args[num_args - 1], "]") != 0) {
+      fprintf(stderr, ERROR_TEST, "missing", "]");
+      return TEST_ERROR;
+    }
+    expr.count--;
+  }
+
+  int value = test_eval(&expr);
+  if (!expr.error && expr.pos < expr.count) {
+    test_error(&expr, "extra argument", expr.args[expr.pos]);
+  }
+  if (expr.error) {
+    return TEST_ERROR;
+  }
+  return value ? TEST_TRUE : TEST_FALSE;
+}
+
+/**
+ * @brief The copy builtin, also run as cat when it is given no options. Every file,
+ * or the input for - or no files at all, is copied to the output in order. The
+ * bytes are moved by the kernel where it can, see copy_fd.
+ *
+ * @param subcommand A parsed command from the commandline
+ * @param list_env Not used
+ * @param io Where the input comes from and the output goes
+ * @return int 0 if every file was copied, else 1
+ */
+int handle_copy(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io) {
+  int num_args = count_args(subcommand);
+  int status = 0;
+
+  fflush(io->stream); // Anything printed before goes first
+  for (int i = 1; i < num_args || i == 1; i++) {
+    char *name = i < num_args ? subcommand->exec_args[i] : "-";
+    int from_input = strcmp(name, "-") == 0;
+    int fd = from_input ? io->in : open(name, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      fprintf(stderr, ERROR_COPY_OPEN, name, strerror(errno));
+      status = 1;
+      continue;
+    }
+
+    if (copy_fd(fd, io->out) == -1) {
+      int error = errno;
+      if (error == EPIPE) { // The reader is gone, there is no one to copy the rest to
+        if (!from_input) {
+          close(fd);
+        }
+        return 1;
+      }
+      fprintf(stderr, ERROR_COPY_FAILED, name, strerror(error));
+      status = 1;
+    }
+    if (!from_input) {
+      close(fd);
+    }
+  }
+  return status;
+}
@@ -0,0 +1,14 @@
+#ifndef UTILITIES_H
+#define UTILITIES_H
+
+#include "datastructures.h"
+#include "internal.h"
+
+int handle_echo(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+int handle_printf(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+int handle_true(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+int handle_false(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+int handle_test(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+int handle_copy(struct subcommand *subcommand, struct list_head *list_env, struct internal_io *io); 
+
+#endif
@@ -0,0 +1,528 @@
+/**
+ * @file worker.c
+ * @author John Gable
+ * @author Hannah Moats
+ * @author Isabella Boone
+ * @brief Runs queued jobs for another shell. sush --worker SOCKET listens on a Unix
+ * domain socket, and a shell that has added it with worker add sends it jobs from its
+ * queue. Each connection carries one job: the args, environment and working directory
+ * go one way, the job's output and then its exit code come back as it runs. Closing
+ * the connection early kills the job. The same functions are used on both ends.
+ * The socket can only be used by the user running the worker, since a job can run
+ * any command as that user.
+ *
+ * Everything sent is a frame, a header with the frame's type and length followed by
+ * that many bytes. A connection that only sends FRAME_HELLO gets back how many jobs
+ * the worker wants to run at once.
+ * @version 0.1
+ * @date 2021-04-26
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+#define _GNU_SOURCE // for accept4
+#include <errno.h> // for errno
+#include <fcntl.h> // for open
+#include <poll.h> // for poll
+#include <signal.h> // for signal and kill
+#include <stdio.h> // for open_memstream
+#include <stdlib.h> // for memory allocation
+#include <string.h> // for string handling
+#include <unistd.h> // for fork, read and close
+#include <sys/socket.h> // for the socket calls
+#include <sys/stat.h> // for lstat
+#include <sys/un.h> // for sockaddr_un
+#include <sys/wait.h> // for waitpid
+
+#include "worker.h"
+#include "executor.h"
+#include "error.h"
+
+#define FRAME_MAX (16 << 20) // Largest frame accepted, a job's args and environment must fit
+#define OUTPUT_CHUNK 65536 // Most output sent in one frame
+#define ACCEPT_BACKOFF_MS 100 // How long to wait when out of file descriptors
+
+/**
+ * @brief Fills a socket address with a path.
+ *
+ * @param addr The address
+ * @param path The socket's path
+ * @return int 0 on success, -1 if the path is too long
+ */
+static int socket_address(struct sockaddr_un *addr, const char *path) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+/**
+ * @brief Sends all of a buffer, without SIGPIPE if the other end is gone.
+ *
+ * @param fd The socket
+ * @param data The bytes
+ * @param size The number of bytes
+ * @return int 0 on success, -1 on error
+ */
+static int send_all(int fd, const void *data, size_t size) {
+  const char *bytes = data;
+  while (size > 0) {
+    ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+    if (sent == -1 && errno == EINTR) {
+      continue;
+    } else if (sent == -1) {
+      return -1;
+    }
+    bytes += sent;
+    size -= sent;
+  }
+  return 0;
+}
+
+/**
+ * @brief Reads exactly size bytes.
+ *
+ * @param fd The socket
+ * @param data Where the bytes go
+ * @param size The number of bytes
+ * @return int 0 on success, -1 on error or if the connection ends first
+ */
+static int read_all(int fd, void *data, size_t size) {
+  char *bytes = data;
+  while (size > 0) {
+    ssize_t got = read(fd, bytes, size);
+    if (got == -1 && errno == EINTR) {
+      continue;
+    } else if (got <= 0) {
+      return -1;
+    }
+    bytes += got;
+    size -= got;
+  }
+  return 0;
+}
+
+/**
+ * @brief Sends a frame.
+ *
+ * @param fd The socket
+ * @param type What the frame holds
+ * @param data The frame's bytes
+ * @param length The number of bytes
+ * @return int 0 on success, -1 on error
+ */
+int worker_send_frame(int fd, enum Worker_Frame type, const void *data, uint32_t length) {
+  struct frame_header header = { type, length };
+  if (send_all(fd, &header, sizeof(header)) == -1) {
+    return -1;
+  }
+  return length == 0 ? 0 : send_all(fd, data, length);
+}
+
+/**
+ * @brief Reads a frame.
+ *
+ * @param fd The socket
+ * @param type Set to what the frame holds
+ * @param data Set to the frame's bytes with a NUL after them, freed by the caller
+ * @param length Set to the number of bytes
+ * @return int 0 on success, -1 on error or at the end of the connection
+ */
+int worker_read_frame(int fd, enum Worker_Frame *type, char **data, uint32_t *length) {
+  struct frame_header header;
+  if (read_all(fd, &header, sizeof(header)) == -1 || header.length > FRAME_MAX) {
+    return -1;
+  }
+  *data = malloc(header.length + 1);
+  if (read_all(fd, *data, header.length) == -1) {
+    free(*data);
+    return -1;
+  }
+  (*data)[header.length] = '\0';
+  *type = header.type;
+  *length = header.length;
+  return 0;
+}
+
+/**
+ * @brief Reads what has arrived on a nonblocking socket, up to the end of the frame
+ * being read, so a worker that stops part way through a frame never blocks the reader.
+ *
+ * @param fd The socket
+ * @param reader The frame read so far, starts zeroed
+ * @param type Set to what the frame holds once it is complete
+ * @param data Set to the frame's bytes with a NUL after them once it is complete, freed by the caller
+ * @param length Set to the number of bytes once it is complete
+ * @return int 1 if a frame is complete, 0 if more has to arrive, -1 on error or at the end of the connection
+ */
+int worker_read_some(int fd, struct frame_reader *reader, enum Worker_Frame *type, char **data, uint32_t *length) {
+  for (;;) {
+    size_t wanted;
+    char *into;
+    if (reader->used < sizeof(reader->header)) {
+      wanted = sizeof(reader->header) - reader->used;
+      into = (char *)&reader->header + reader->used;
+    } else {
+      if (reader->header.length > FRAME_MAX) {
+        return -1;
+      }
+      if (reader->data == NULL) {
+        reader->data = malloc(reader->header.length + 1);
+      }
+      wanted = sizeof(reader->header) + reader->header.length - reader->used;
+      into = reader->data + reader->used - sizeof(reader->header);
+    }
+    if (wanted == 0) { // The whole frame is here
+      break;
+    }
+
+    ssize_t got = read(fd, into, wanted);
+    if (got == -1 && errno == EINTR) {
+      continue;
+    } else if (got == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return 0;
+    } else if (got <= 0) {
+      return -1;
+    }
+    reader->used += got;
+  }
+
+  reader->data[reader->header.length] = '\0';
+  *type = reader->header.type;
+  *data = reader->data;
+  *length = reader->header.length;
+  reader->data = NULL;
+  reader->used = 0;
+  return 1;
+}
+
+/**
+ * @brief Frees a frame that was only partly read.
+ *
+ * @param reader The frame
+ */
+void worker_reader_free(struct frame_reader *reader) {
+  free(reader->data);
+  reader->data = NULL;
+  reader->used = 0;
+}
+
+/**
+ * @brief Connects to a worker.
+ *
+ * @param path The worker's socket
+ * @return int The connected socket, or -1 on error
+ */
+int worker_connect(const char *path) {
+  struct sockaddr_un addr;
+  if (socket_address(&addr, path) == -1) {
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Asks a worker how many jobs it wants to run at once.
+ *
+ * @param path The worker's socket
+ * @return int The number of jobs, or -1 if it did not answer
+ */
+int worker_hello(const char *path) {
+  int fd = worker_connect(path);
+  if (fd == -1) {
+    return -1;
+  }
+
+  enum Worker_Frame type;
+  char *data;
+  uint32_t length;
+  uint32_t slots = 0;
+  if (worker_send_frame(fd, FRAME_HELLO, NULL, 0) == 0 && worker_read_frame(fd, &type, &data, &length) == 0) {
+    if (type == FRAME_SLOTS && length == sizeof(slots)) {
+      memcpy(&slots, data, sizeof(slots));
+    }
+    free(data);
+  }
+  close(fd);
+  return slots > 0 ? (int)slots : -1;
+}
+
+/**
+ * @brief Adds NULL terminated strings to a job being written, their count first.
+ *
+ * @param stream The job
+ * @param strings The strings
+ */
+static void write_strings(FILE *stream, char **strings) {
+  uint32_t count = 0;
+  while (strings[count] != NULL) {
+    count++;
+  }
+  fwrite(&count, sizeof(count), 1, stream);
+  for (uint32_t i = 0; i < count; i++) {
+    fwrite(strings[i], 1, strlen(strings[i]) + 1, stream);
+  }
+}
+
+/**
+ * @brief Sends a job to a worker.
+ *
+ * @param path The worker's socket
+ * @param args The NULL terminated args of the job
+ * @param env The NULL terminated environment of the job
+ * @param cwd The directory the job runs in
+ * @return int The socket the job's output and exit code come back on, or -1 on error
+ */
+int worker_start_job(const char *path, char **args, char **env, const char *cwd) {
+  char *job;
+  size_t size;
+  FILE *stream = open_memstream(&job, &size);
+  if (stream == NULL) {
+    return -1;
+  }
+  fwrite(cwd, 1, strlen(cwd) + 1, stream);
+  write_strings(stream, args);
+  write_strings(stream, env);
+  fclose(stream);
+
+  int fd = worker_connect(path);
+  if (fd != -1 && worker_send_frame(fd, FRAME_JOB, job, size) == -1) {
+    close(fd);
+    fd = -1;
+  }
+  free(job);
+  return fd;
+}
+
+/**
+ * @brief Reads NULL terminated strings back out of a job.
+ *
+ * @param cursor Where the count is, moved past the strings
+ * @param end The end of the job
+ * @return char** The strings, pointing into the job, or NULL if they do not fit
+ */
+static char **read_strings(char **cursor, char *end) {
+  uint32_t count;
+  if (end - *cursor < (ssize_t)sizeof(count)) {
+    return NULL;
+  }
+  memcpy(&count, *cursor, sizeof(count));
+  *cursor += sizeof(count);
+  if (count > (size_t)(end - *cursor)) { // Every string takes at least its NUL
+    return NULL;
+  }
+
+  char **strings = calloc(count + 1, sizeof(char *));
+  for (uint32_t i = 0; i < count; i++) {
+    char *nul = memchr(*cursor, '\0', end - *cursor);
+    if (nul == NULL) {
+      free(strings);
+      return NULL;
+    }
+    strings[i] = *cursor;
+    *cursor = nul + 1;
+  }
+  return strings;
+}
+
+/**
+ * @brief Sends a message to the shell that sent the job as part of the job's output.
+ *
+ * @param fd The connection
+ * @param message The message
+ */
+static void send_output(int fd, const char *message) {
+  worker_send_frame(fd, FRAME_OUTPUT, message, strlen(message));
+}
+
+/**
+ * @brief Runs one job and streams its output and exit code back. Its stdout and stderr
+ * go to the same pipe, so they come back merged, as a job run in the shell writes both
+ * to its output file. If the connection is closed before the job is done, the job is
+ * killed.
+ *
+ * @param fd The connection
+ * @param job The job's frame
+ * @param length Bytes in the job
+ * @return int The job's exit code
+ */
+static int run_job(int fd, char *job, uint32_t length) {
+  char *end = job + length;
+  char *cursor = memchr(job, '\0', length);
+  char **args = NULL;
+  char **env = NULL;
+  char message[256];
+  if (cursor != NULL) {
+    cursor++;
+    args = read_strings(&cursor, end);
+    env = args != NULL ? read_strings(&cursor, end) : NULL;
+  }
+  if (args == NULL || env == NULL || args[0] == NULL) {
+    free(args);
+    free(env);
+    return 2;
+  }
+  if (chdir(job) == -1) {
+    snprintf(message, sizeof(message), ERROR_WORKER_CWD, job, strerror(errno));
+    send_output(fd, message);
+    free(args);
+    free(env);
+    return 1;
+  }
+
+  int out[2];
+  int in = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  pid_t pid = -1;
+  if (in != -1 && pipe2(out, O_CLOEXEC) == 0) {
+    pid = spawn_command(args, env, in, out[1], out[1]);
+    close(out[1]);
+  }
+  if (pid == -1) {
+    snprintf(message, sizeof(message), ERROR_CMD_NOT_FOUND, args[0]);
+    send_output(fd, message);
+    free(args);
+    free(env);
+    return 127;
+  }
+  close(in);
+  free(args);
+  free(env);
+
+  // Relay the output until the job closes it, killing the job if the shell goes away
+  struct pollfd polls[2] = { { .fd = out[0], .events = POLLIN }, { .fd = fd, .events = POLLIN } };
+  char *buf = malloc(OUTPUT_CHUNK);
+  for (;;) {
+    if (poll(polls, 2, -1) == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (polls[1].revents != 0) {
+      kill(pid, SIGKILL);
+      polls[1].fd = -1; // Only the output is left to wait for
+    }
+    if (polls[0].revents != 0) {
+      ssize_t got = read(out[0], buf, OUTPUT_CHUNK);
+      if (got == -1 && errno == EINTR) {
+        continue;
+      } else if (got <= 0) {
+        break;
+      }
+      worker_send_frame(fd, FRAME_OUTPUT, buf, got);
+    }
+  }
+  free(buf);
+  close(out[0]);
+
+  int status;
+  pid_t result;
+  while ((result = waitpid(pid, &status, 0)) == -1 && errno == EINTR) {
+    continue;
+  }
+  return result == -1 ? 1 : exit_code_from_status(status);
+}
+
+/**
+ * @brief Answers one connection.
+ *
+ * @param fd The connection
+ */
+static void serve_connection(int fd) {
+  enum Worker_Frame type;
+  char *data;
+  uint32_t length;
+  if (worker_read_frame(fd, &type, &data, &length) == -1) {
+    return;
+  }
+
+  if (type == FRAME_HELLO) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t slots = cpus > 0 ? cpus : 1;
+    worker_send_frame(fd, FRAME_SLOTS, &slots, sizeof(slots));
+  } else if (type == FRAME_JOB) {
+    int32_t status = run_job(fd, data, length);
+    worker_send_frame(fd, FRAME_STATUS, &status, sizeof(status));
+  }
+  free(data);
+}
+
+/**
+ * @brief Checks that a connection comes from the user running the worker.
+ *
+ * @param fd The connection
+ * @return int 1 if it does, else 0
+ */
+static int same_user(int fd) {
+  struct ucred cred;
+  socklen_t size = sizeof(cred);
+  return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 && cred.uid == getuid();
+}
+
+/**
+ * @brief Runs the shell as a worker, answering every connection to the socket in its
+ * own forked child until the worker is killed.
+ *
+ * @param path Where the socket is made, a socket already there is replaced
+ * @return int Only returns if the socket could not be made or used, with exit code 1
+ */
+int run_worker(const char *path) {
+  struct sockaddr_un addr;
+  struct stat sb;
+  int fd = -1;
+  if (socket_address(&addr, path) == 0) {
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  }
+  if (fd != -1 && lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode)) { // Left by a worker that is gone
+    unlink(path);
+  }
+  mode_t mask = umask(0177); // Only this user may connect, the socket is made 0600
+  int bound = fd != -1 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+  umask(mask);
+  if (!bound || listen(fd, SOMAXCONN) == -1) {
+    fprintf(stderr, ERROR_WORKER_SOCKET, path, strerror(errno));
+    return 1;
+  }
+
+  signal(SIGCHLD, SIG_IGN); // Children answering connections are never waited for
+  for (;;) {
+    int connection = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+    if (connection == -1 && (errno == EINTR || errno == ECONNABORTED)) {
+      continue;
+    } else if (connection == -1 && (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)) {
+      poll(NULL, 0, ACCEPT_BACKOFF_MS); // Connections wait in the backlog until jobs finish
+      continue;
+    } else if (connection == -1) {
+      fprintf(stderr, ERROR_WORKER_SOCKET, path, strerror(errno));
+      close(fd);
+      return 1;
+    }
+    if (!same_user(connection)) {
+      close(connection);
+      continue;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) { // Child process
+      signal(SIGCHLD, SIG_DFL); // The job is waited for
+      close(fd);
+      serve_connection(connection);
+      _exit(0);
+    }
+    close(connection);
+  }
+}
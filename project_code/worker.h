@@ -0,0 +1,50 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stdint.h>
+
+/**
+ * @brief What a frame sent between a shell and a worker holds. 
+ */
+enum Worker_Frame {
+  FRAME_HELLO, // Asks how many jobs the worker runs at once, nothing after the header
+  FRAME_SLOTS, // The answer, a uint32_t
+  FRAME_JOB, // The working directory, then the args and the environment, each a count and strings
+  FRAME_OUTPUT, // Some of what the job printed
+  FRAME_STATUS // The job's exit code, an int32_t, the last frame of a job
+}; 
+
+/**
+ * @brief The start of every frame. 
+ * 
+ * @param type What the frame holds, an enum Worker_Frame
+ * @param length Bytes after the header
+ */
+struct frame_header {
+  uint32_t type; 
+  uint32_t length; 
+}; 
+
+/**
+ * @brief A frame being read from a nonblocking socket a piece at a time. 
+ * 
+ * @param header The frame's header, once it has all been read
+ * @param used Bytes of the header and then the frame's bytes read so far
+ * @param data The frame's bytes, allocated once the header is read
+ */
+struct frame_reader {
+  struct frame_header header; 
+  size_t used; 
+  char *data; 
+}; 
+
+int worker_send_frame(int fd, enum Worker_Frame type, const void *data, uint32_t length); 
+int worker_read_frame(int fd, enum Worker_Frame *type, char **data, uint32_t *length); 
+int worker_read_some(int fd, struct frame_reader *reader, enum Worker_Frame *type, char **data, uint32_t *length); 
+void worker_reader_free(struct frame_reader *reader); 
+int worker_connect(const char *path); 
+int worker_hello(const char *path); 
+int worker_start_job(const char *path, char **args, char **env, const char *cwd); 
+int run_worker(const char *path); 
+
+#endif